@@ -0,0 +1,31 @@
+# FFmpeg libraries for decoding audio responses. On Windows and macOS they come with the OBS
+# dependencies (obs-deps, on CMAKE_PREFIX_PATH), on Linux from the system (pkg-config).
+
+find_package(PkgConfig QUIET)
+if(PKG_CONFIG_FOUND)
+  pkg_check_modules(PC_FFMPEG QUIET libavformat libavcodec libavutil)
+endif()
+
+find_path(
+  FFMPEG_INCLUDE_DIR
+  NAMES libavformat/avformat.h
+  HINTS ${PC_FFMPEG_INCLUDE_DIRS}
+  PATH_SUFFIXES ffmpeg)
+
+add_library(ffmpeg_audio INTERFACE)
+
+foreach(_ffmpeg_lib IN ITEMS avformat avcodec avutil)
+  find_library(
+    FFMPEG_${_ffmpeg_lib}_LIBRARY
+    NAMES ${_ffmpeg_lib}
+    HINTS ${PC_FFMPEG_LIBRARY_DIRS})
+  if(NOT FFMPEG_${_ffmpeg_lib}_LIBRARY)
+    message(FATAL_ERROR "FFmpeg library ${_ffmpeg_lib} not found")
+  endif()
+  target_link_libraries(ffmpeg_audio INTERFACE "${FFMPEG_${_ffmpeg_lib}_LIBRARY}")
+endforeach()
+
+if(NOT FFMPEG_INCLUDE_DIR)
+  message(FATAL_ERROR "FFmpeg headers not found")
+endif()
+target_include_directories(ffmpeg_audio SYSTEM INTERFACE "${FFMPEG_INCLUDE_DIR}")
@@ -0,0 +1,396 @@
+#include "audio-player.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct url_source_audio_player {
+	obs_source_t *source = nullptr;
+	std::mutex mutex;
+	// signalled when clip data arrives, a clip starts or the player stops
+	std::condition_variable cv;
+	std::thread thread;
+	bool running = true;
+	// bumped by every audio_player_begin, a decoder still reading an older clip stops
+	uint64_t clip_generation = 0;
+	// the encoded bytes of the current clip, read by the decoder as they arrive
+	std::vector<uint8_t> clip_data;
+	size_t clip_read_pos = 0;
+	bool clip_complete = false;
+};
+
+namespace {
+
+// how much of the download FFmpeg asks for at a time
+constexpr int avio_buffer_size = 4096;
+// don't wait for more than this much of the download to detect the format
+constexpr int64_t max_probe_size = 64 * 1024;
+// how far decoded audio may run ahead of the clock. OBS buffers it until it's due, so this is
+// only what's dropped when a clip is stopped by the next one.
+constexpr uint64_t max_audio_lead_ns = 300000000ULL;
+
+// One clip being decoded on the player's thread
+struct clip_decoder {
+	url_source_audio_player *player;
+	uint64_t generation;
+	AVCodecContext *codec = nullptr;
+	AVFrame *frame = nullptr;
+	// clock time of the clip's first sample and the length of the audio output so far
+	uint64_t start_ns = 0;
+	uint64_t time_ns = 0;
+};
+
+std::string av_error_string(int error)
+{
+	char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+	av_strerror(error, buffer, sizeof(buffer));
+	return buffer;
+}
+
+// the player's mutex must be held
+bool is_clip_cancelled(const clip_decoder *decoder)
+{
+	return !decoder->player->running ||
+	       decoder->player->clip_generation != decoder->generation;
+}
+
+int read_clip_data(void *opaque, uint8_t *buffer, int buffer_size)
+{
+	clip_decoder *decoder = static_cast<clip_decoder *>(opaque);
+	url_source_audio_player *player = decoder->player;
+
+	std::unique_lock<std::mutex> lock(player->mutex);
+	// block until more of the download arrives
+	player->cv.wait(lock, [&] {
+		return is_clip_cancelled(decoder) || player->clip_complete ||
+		       player->clip_read_pos < player->clip_data.size();
+	});
+	if (is_clip_cancelled(decoder)) {
+		return AVERROR_EXIT;
+	}
+	const size_t available = player->clip_data.size() - player->clip_read_pos;
+	if (available == 0) {
+		return AVERROR_EOF;
+	}
+	const size_t size = std::min(available, (size_t)buffer_size);
+	memcpy(buffer, player->clip_data.data() + player->clip_read_pos, size);
+	player->clip_read_pos += size;
+	return (int)size;
+}
+
+int interrupt_clip(void *opaque)
+{
+	clip_decoder *decoder = static_cast<clip_decoder *>(opaque);
+	std::lock_guard<std::mutex> lock(decoder->player->mutex);
+	return is_clip_cancelled(decoder) ? 1 : 0;
+}
+
+enum audio_format convert_sample_format(int format)
+{
+	switch (format) {
+	case AV_SAMPLE_FMT_U8:
+		return AUDIO_FORMAT_U8BIT;
+	case AV_SAMPLE_FMT_S16:
+		return AUDIO_FORMAT_16BIT;
+	case AV_SAMPLE_FMT_S32:
+		return AUDIO_FORMAT_32BIT;
+	case AV_SAMPLE_FMT_FLT:
+		return AUDIO_FORMAT_FLOAT;
+	case AV_SAMPLE_FMT_U8P:
+		return AUDIO_FORMAT_U8BIT_PLANAR;
+	case AV_SAMPLE_FMT_S16P:
+		return AUDIO_FORMAT_16BIT_PLANAR;
+	case AV_SAMPLE_FMT_S32P:
+		return AUDIO_FORMAT_32BIT_PLANAR;
+	case AV_SAMPLE_FMT_FLTP:
+		return AUDIO_FORMAT_FLOAT_PLANAR;
+	default:
+		return AUDIO_FORMAT_UNKNOWN;
+	}
+}
+
+enum speaker_layout convert_speaker_layout(int channels)
+{
+	switch (channels) {
+	case 1:
+		return SPEAKERS_MONO;
+	case 2:
+		return SPEAKERS_STEREO;
+	case 3:
+		return SPEAKERS_2POINT1;
+	case 4:
+		return SPEAKERS_4POINT0;
+	case 5:
+		return SPEAKERS_4POINT1;
+	case 6:
+		return SPEAKERS_5POINT1;
+	case 8:
+		return SPEAKERS_7POINT1;
+	default:
+		return SPEAKERS_UNKNOWN;
+	}
+}
+
+int frame_channels(const AVFrame *frame)
+{
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+	return frame->ch_layout.nb_channels;
+#else
+	return frame->channels;
+#endif
+}
+
+// Wait until the audio at timestamp is close enough to be output. False if the clip stopped.
+bool wait_until_due(clip_decoder *decoder, uint64_t timestamp)
+{
+	std::unique_lock<std::mutex> lock(decoder->player->mutex);
+	while (!is_clip_cancelled(decoder)) {
+		const uint64_t now = os_gettime_ns();
+		if (timestamp <= now + max_audio_lead_ns) {
+			return true;
+		}
+		decoder->player->cv.wait_for(
+			lock, std::chrono::nanoseconds(timestamp - now - max_audio_lead_ns));
+	}
+	return false;
+}
+
+// Push a decoded frame to the source's audio output. False if the clip should stop.
+bool output_frame(clip_decoder *decoder)
+{
+	const AVFrame *frame = decoder->frame;
+	const enum audio_format format = convert_sample_format(frame->format);
+	const int channels = frame_channels(frame);
+	if (format == AUDIO_FORMAT_UNKNOWN || frame->sample_rate <= 0) {
+		obs_log(LOG_WARNING, "Unsupported audio sample format %d, %d Hz", frame->format,
+			frame->sample_rate);
+		return false;
+	}
+
+	struct obs_source_audio audio = {};
+	const int planes = av_sample_fmt_is_planar((enum AVSampleFormat)frame->format)
+				   ? std::min(channels, MAX_AV_PLANES)
+				   : 1;
+	for (int i = 0; i < planes; i++) {
+		audio.data[i] = frame->extended_data[i];
+	}
+	audio.frames = (uint32_t)frame->nb_samples;
+	audio.format = format;
+	audio.speakers = convert_speaker_layout(channels);
+	audio.samples_per_sec = (uint32_t)frame->sample_rate;
+
+	if (decoder->start_ns == 0) {
+		// the clip starts playing now
+		decoder->start_ns = os_gettime_ns();
+	}
+	audio.timestamp = decoder->start_ns + decoder->time_ns;
+	if (!wait_until_due(decoder, audio.timestamp)) {
+		return false;
+	}
+	obs_source_output_audio(decoder->player->source, &audio);
+	decoder->time_ns += util_mul_div64((uint64_t)frame->nb_samples, 1000000000ULL,
+					   (uint64_t)frame->sample_rate);
+	return true;
+}
+
+// Decode a packet (or flush the decoder with nullptr). False if the clip should stop.
+bool decode_packet(clip_decoder *decoder, const AVPacket *packet)
+{
+	int ret = avcodec_send_packet(decoder->codec, packet);
+	if (ret < 0 && ret != AVERROR_EOF) {
+		// skip a broken packet, the next ones may decode
+		obs_log(LOG_DEBUG, "Failed to decode audio packet: %s",
+			av_error_string(ret).c_str());
+		return true;
+	}
+	while ((ret = avcodec_receive_frame(decoder->codec, decoder->frame)) >= 0) {
+		const bool keep_playing = output_frame(decoder);
+		av_frame_unref(decoder->frame);
+		if (!keep_playing) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void decode_clip(clip_decoder *decoder, AVFormatContext *format)
+{
+	// the stream parameters of audio formats are known from their header, skip
+	// avformat_find_stream_info so decoding doesn't wait for more of the download
+	const int stream_index =
+		av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+	if (stream_index < 0) {
+		obs_log(LOG_WARNING, "No audio stream found in the response");
+		return;
+	}
+	const AVCodecParameters *params = format->streams[stream_index]->codecpar;
+	const AVCodec *codec = avcodec_find_decoder(params->codec_id);
+	if (codec == nullptr) {
+		obs_log(LOG_WARNING, "No decoder for audio codec %s",
+			avcodec_get_name(params->codec_id));
+		return;
+	}
+	decoder->codec = avcodec_alloc_context3(codec);
+	if (decoder->codec == nullptr ||
+	    avcodec_parameters_to_context(decoder->codec, params) < 0 ||
+	    avcodec_open2(decoder->codec, codec, nullptr) < 0) {
+		obs_log(LOG_WARNING, "Failed to open audio decoder %s", codec->name);
+		return;
+	}
+
+	AVPacket *packet = av_packet_alloc();
+	bool keep_playing = packet != nullptr;
+	while (keep_playing && av_read_frame(format, packet) >= 0) {
+		if (packet->stream_index == stream_index) {
+			keep_playing = decode_packet(decoder, packet);
+		}
+		av_packet_unref(packet);
+	}
+	if (keep_playing) {
+		// the download is done - get the last frames out of the decoder
+		decode_packet(decoder, nullptr);
+	}
+	av_packet_free(&packet);
+}
+
+void play_clip(url_source_audio_player *player, uint64_t generation)
+{
+	clip_decoder decoder = {player, generation};
+	decoder.frame = av_frame_alloc();
+
+	uint8_t *avio_buffer = static_cast<uint8_t *>(av_malloc(avio_buffer_size));
+	// no seek callback: the download is read front to back, and demuxers don't try to read
+	// the end of the clip (e.g. for its duration) before it's there
+	AVIOContext *avio = avio_buffer != nullptr
+				    ? avio_alloc_context(avio_buffer, avio_buffer_size, 0, &decoder,
+							 read_clip_data, nullptr, nullptr)
+				    : nullptr;
+	AVFormatContext *format = avformat_alloc_context();
+
+	if (decoder.frame != nullptr && avio != nullptr && format != nullptr) {
+		format->pb = avio;
+		format->flags |= AVFMT_FLAG_CUSTOM_IO;
+		format->format_probesize = max_probe_size;
+		format->interrupt_callback.callback = interrupt_clip;
+		format->interrupt_callback.opaque = &decoder;
+		// avformat_open_input frees the context when it fails
+		const int ret = avformat_open_input(&format, nullptr, nullptr, nullptr);
+		if (ret == 0) {
+			decode_clip(&decoder, format);
+		} else if (ret != AVERROR_EXIT) {
+			obs_log(LOG_WARNING, "Failed to open the audio response: %s",
+				av_error_string(ret).c_str());
+		}
+	} else {
+		obs_log(LOG_ERROR, "Failed to allocate the audio decoder");
+	}
+
+	avformat_close_input(&format);
+	if (avio != nullptr) {
+		av_freep(&avio->buffer);
+		avio_context_free(&avio);
+	} else {
+		av_free(avio_buffer);
+	}
+	avcodec_free_context(&decoder.codec);
+	av_frame_free(&decoder.frame);
+}
+
+void player_loop(url_source_audio_player *player)
+{
+	std::unique_lock<std::mutex> lock(player->mutex);
+	uint64_t played_generation = 0;
+	while (true) {
+		player->cv.wait(lock, [&] {
+			return !player->running || player->clip_generation != played_generation;
+		});
+		if (!player->running) {
+			break;
+		}
+		played_generation = player->clip_generation;
+		lock.unlock();
+
+		play_clip(player, played_generation);
+
+		lock.lock();
+		if (player->clip_generation == played_generation) {
+			// done with the clip's bytes
+			player->clip_data.clear();
+			player->clip_data.shrink_to_fit();
+			player->clip_read_pos = 0;
+		}
+	}
+}
+
+} // namespace
+
+url_source_audio_player *audio_player_create(obs_source_t *source)
+{
+	url_source_audio_player *player = new url_source_audio_player;
+	player->source = source;
+	return player;
+}
+
+void audio_player_destroy(url_source_audio_player *player)
+{
+	if (player == nullptr) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(player->mutex);
+		player->running = false;
+	}
+	player->cv.notify_all();
+	if (player->thread.joinable()) {
+		player->thread.join();
+	}
+	delete player;
+}
+
+void audio_player_begin(url_source_audio_player *player)
+{
+	std::lock_guard<std::mutex> lock(player->mutex);
+	if (!player->thread.joinable()) {
+		// started with the first clip
+		player->thread = std::thread(player_loop, player);
+	}
+	player->clip_generation++;
+	player->clip_data.clear();
+	player->clip_read_pos = 0;
+	player->clip_complete = false;
+	player->cv.notify_all();
+}
+
+void audio_player_write(url_source_audio_player *player, const uint8_t *data, size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(player->mutex);
+		player->clip_data.insert(player->clip_data.end(), data, data + size);
+	}
+	player->cv.notify_all();
+}
+
+void audio_player_end(url_source_audio_player *player)
+{
+	{
+		std::lock_guard<std::mutex> lock(player->mutex);
+		player->clip_complete = true;
+	}
+	player->cv.notify_all();
+}
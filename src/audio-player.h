@@ -0,0 +1,28 @@
+#ifndef AUDIO_PLAYER_H
+#define AUDIO_PLAYER_H
+
+#include <obs.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Plays encoded audio (MP3, WAV, OGG, FLAC, ...) through a source's own audio output.
+// The encoded bytes are written as they download and decoded with FFmpeg on the player's
+// thread as they arrive, so playback starts before the download is done.
+struct url_source_audio_player;
+
+url_source_audio_player *audio_player_create(obs_source_t *source);
+
+// Stop playback and the player's thread
+void audio_player_destroy(url_source_audio_player *player);
+
+// Start a new clip. A clip that is still playing is stopped.
+void audio_player_begin(url_source_audio_player *player);
+
+// Append encoded bytes of the current clip
+void audio_player_write(url_source_audio_player *player, const uint8_t *data, size_t size);
+
+// All the bytes of the current clip were written, it plays to its end
+void audio_player_end(url_source_audio_player *player);
+
+#endif // AUDIO_PLAYER_H
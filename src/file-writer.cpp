@@ -0,0 +1,110 @@
+#include "file-writer.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+std::mutex writer_mutex;
+std::condition_variable writer_cv;
+std::thread writer_thread;
+bool writer_running = false;
+// path -> latest text not yet written
+std::map<std::string, std::string> pending_writes;
+
+bool write_file_atomically(const std::string &file_path, const std::string &text)
+{
+	const std::filesystem::path path = std::filesystem::u8path(file_path);
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			obs_log(LOG_ERROR, "Failed to open file '%s'", temp_path.u8string().c_str());
+			return false;
+		}
+		file.write(text.data(), (std::streamsize)text.size());
+		if (!file) {
+			obs_log(LOG_ERROR, "Failed to write file '%s'", temp_path.u8string().c_str());
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (!ec) {
+		return true;
+	}
+
+	// the rename can fail e.g. on Windows while a reader has the file open - write in place
+	obs_log(LOG_WARNING, "Failed to replace file '%s' (%s), writing it directly",
+		file_path.c_str(), ec.message().c_str());
+	std::filesystem::remove(temp_path, ec);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		obs_log(LOG_ERROR, "Failed to open file '%s'", file_path.c_str());
+		return false;
+	}
+	file.write(text.data(), (std::streamsize)text.size());
+	return (bool)file;
+}
+
+void writer_loop()
+{
+	std::unique_lock<std::mutex> lock(writer_mutex);
+	while (true) {
+		writer_cv.wait(lock, [] { return !pending_writes.empty() || !writer_running; });
+		if (pending_writes.empty()) {
+			// stopped and everything was written
+			break;
+		}
+
+		std::map<std::string, std::string> writes;
+		writes.swap(pending_writes);
+		lock.unlock();
+
+		// every queued text is written: unchanged text is skipped before it's queued, and
+		// the file may have been changed or deleted by another program since
+		for (const auto &write : writes) {
+			write_file_atomically(write.first, write.second);
+		}
+
+		lock.lock();
+	}
+}
+
+} // namespace
+
+void file_writer_write(const std::string &file_path, const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(writer_mutex);
+	if (!writer_running) {
+		if (writer_thread.joinable()) {
+			writer_thread.join();
+		}
+		writer_running = true;
+		writer_thread = std::thread(writer_loop);
+	}
+	pending_writes[file_path] = text;
+	writer_cv.notify_one();
+}
+
+void file_writer_stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		writer_running = false;
+	}
+	writer_cv.notify_all();
+	if (writer_thread.joinable()) {
+		writer_thread.join();
+	}
+}
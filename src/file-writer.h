@@ -0,0 +1,25 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Write out the queued files and stop the writer thread. Called on module unload.
+void file_writer_stop(void);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+/**
+  * Queue text to be written to a file by the plugin-wide background writer.
+  * The file is written to a temporary file next to it and renamed over it, so readers never see
+  * a partial file. Rapid updates to the same path are coalesced (only the latest is written).
+  */
+void file_writer_write(const std::string &file_path, const std::string &text);
+
+#endif
+
+#endif // FILE_WRITER_H
@@ -0,0 +1,67 @@
+#include "frame-buffer-pool.h"
+
+#include <util/bmem.h>
+
+namespace {
+
+// free buffers kept around, the rest are released back to the allocator
+const size_t frame_buffer_pool_max_free = 4;
+
+} // namespace
+
+frame_buffer_pool::~frame_buffer_pool()
+{
+	for (auto &buffer : free_buffers) {
+		bfree(buffer.data);
+	}
+}
+
+frame_buffer frame_buffer_pool_acquire(frame_buffer_pool &pool, size_t size)
+{
+	// take the smallest free buffer that fits
+	const size_t none = pool.free_buffers.size();
+	size_t best = none;
+	for (size_t i = 0; i < pool.free_buffers.size(); i++) {
+		const size_t capacity = pool.free_buffers[i].capacity;
+		if (capacity >= size &&
+		    (best == none || capacity < pool.free_buffers[best].capacity)) {
+			best = i;
+		}
+	}
+	if (best != none) {
+		frame_buffer buffer = pool.free_buffers[best];
+		pool.free_buffers[best] = pool.free_buffers.back();
+		pool.free_buffers.pop_back();
+		return buffer;
+	}
+
+	frame_buffer buffer;
+	buffer.data = (uint8_t *)bmalloc(size);
+	buffer.capacity = size;
+	return buffer;
+}
+
+void frame_buffer_pool_release(frame_buffer_pool &pool, frame_buffer &buffer)
+{
+	if (buffer.data == nullptr) {
+		return;
+	}
+	if (pool.free_buffers.size() >= frame_buffer_pool_max_free) {
+		// drop the smallest free buffer, it's the least likely to fit the next render
+		size_t smallest = 0;
+		for (size_t i = 1; i < pool.free_buffers.size(); i++) {
+			if (pool.free_buffers[i].capacity < pool.free_buffers[smallest].capacity) {
+				smallest = i;
+			}
+		}
+		if (pool.free_buffers[smallest].capacity < buffer.capacity) {
+			bfree(pool.free_buffers[smallest].data);
+			pool.free_buffers[smallest] = buffer;
+		} else {
+			bfree(buffer.data);
+		}
+	} else {
+		pool.free_buffers.push_back(buffer);
+	}
+	buffer = frame_buffer();
+}
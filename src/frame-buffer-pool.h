@@ -0,0 +1,31 @@
+#ifndef FRAME_BUFFER_POOL_H
+#define FRAME_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A bmalloc'd pixel buffer and its allocated size
+struct frame_buffer {
+	uint8_t *data = nullptr;
+	size_t capacity = 0;
+};
+
+// Free pixel buffers of a source, reused for the next renders so rendering doesn't allocate
+// a new frame each time. Only accessed from the curl thread.
+struct frame_buffer_pool {
+	std::vector<frame_buffer> free_buffers;
+
+	frame_buffer_pool() = default;
+	frame_buffer_pool(const frame_buffer_pool &) = delete;
+	frame_buffer_pool &operator=(const frame_buffer_pool &) = delete;
+	~frame_buffer_pool();
+};
+
+// Get a buffer of at least size bytes, reusing a free one if it's big enough
+frame_buffer frame_buffer_pool_acquire(frame_buffer_pool &pool, size_t size);
+
+// Return a buffer to the pool
+void frame_buffer_pool_release(frame_buffer_pool &pool, frame_buffer &buffer);
+
+#endif // FRAME_BUFFER_POOL_H
@@ -26,6 +26,9 @@ output_mapping_data deserialize_output_mapping_data(const std::string &data)
 		output_mapping mapping;
 		mapping.name = j_mapping.value("name", "");
 		mapping.output_source = j_mapping.value("output_source", "");
+		if (mapping.output_source == legacy_save_to_setting) {
+			mapping.output_source = publish_to_output_channel;
+		}
 		mapping.template_string = j_mapping.value("template_string", "");
 		mapping.css_props = j_mapping.value("css_props", "");
 		mapping.unhide_output_source = j_mapping.value("unhide_output_source", false);
@@ -46,6 +49,9 @@ nlohmann::json serialize_input_mapping_data(const inputs_data &data)
 		j_input["aggregate"] = input.aggregate;
 		j_input["agg_method"] = input.agg_method;
 		j_input["resize_method"] = input.resize_method;
+		j_input["image_format"] = input.image_format;
+		j_input["image_quality"] = input.image_quality;
+		j_input["image_change_threshold"] = input.image_change_threshold;
 		j.push_back(j_input);
 	}
 	return j;
@@ -63,6 +69,9 @@ inputs_data deserialize_input_mapping_data(const std::string &data)
 		input.aggregate = j_input.value("aggregate", false);
 		input.agg_method = j_input.value("agg_method", -1);
 		input.resize_method = j_input.value("resize_method", "");
+		input.image_format = j_input.value("image_format", "PNG");
+		input.image_quality = j_input.value("image_quality", 80);
+		input.image_change_threshold = j_input.value("image_change_threshold", 1.0f);
 		result.push_back(input);
 	}
 	return result;
@@ -7,8 +7,12 @@
 #include <nlohmann/json.hpp>
 
 const std::string none_internal_rendering = "None / Internal rendering";
-const std::string save_to_setting = "Save to source settings";
+const std::string publish_to_output_channel = "Publish to output channel";
+// the name publish_to_output_channel mappings were saved with before, when they wrote the
+// text to settings["output"]
+const std::string legacy_save_to_setting = "Save to source settings";
 const std::string file_output_rendering = "File output";
+const std::string shared_memory_output = "Shared memory output";
 
 struct output_mapping {
 	std::string name;
@@ -19,6 +23,18 @@ struct output_mapping {
 	std::string file_path;
 };
 
+inline bool operator==(const output_mapping &a, const output_mapping &b)
+{
+	return a.name == b.name && a.output_source == b.output_source &&
+	       a.template_string == b.template_string && a.css_props == b.css_props &&
+	       a.unhide_output_source == b.unhide_output_source && a.file_path == b.file_path;
+}
+
+inline bool operator!=(const output_mapping &a, const output_mapping &b)
+{
+	return !(a == b);
+}
+
 struct output_mapping_data {
 	std::vector<output_mapping> mappings;
 };
@@ -33,7 +49,16 @@ struct input_data {
 	bool aggregate = false;
 	int agg_method = -1;
 	std::string resize_method;
+	// encoding of image inputs: "PNG", "JPEG" or "WebP", and the JPEG/WebP quality
+	std::string image_format = "PNG";
+	int image_quality = 80;
+	// with no_same: an image input is sent again once it changed more than this (percent)
+	float image_change_threshold = 1.0f;
 	std::string last_obs_text_source_value;
+	// thumbnail of the last image input that was sent, see compute_image_thumbnail
+	std::vector<uint8_t> last_image_thumbnail;
+	// thumbnail of the image in the request being sent, kept once the request succeeded
+	std::vector<uint8_t> pending_image_thumbnail;
 	std::string aggregate_to_empty_buffer;
 	uint64_t agg_buffer_begin_ts;
 };
@@ -4,132 +4,170 @@
 
 #include <obs-module.h>
 
-#include <QBuffer>
+#include <QIODevice>
 #include <QImage>
+#include <QImageWriter>
 
-#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-void init_source_render_data(source_render_data *tf)
-{
-	tf->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
-	tf->stagesurface = nullptr;
-}
+namespace {
 
-void destroy_source_render_data(source_render_data *tf)
-{
-	if (tf->texrender) {
-		gs_texrender_destroy(tf->texrender);
-		tf->texrender = nullptr;
+// A write-only device that base64 encodes what's written into a string, so an image encoder
+// can write straight into the base64 text without an intermediate buffer
+class Base64Writer : public QIODevice {
+public:
+	explicit Base64Writer(std::string &output) : output(output) {}
+
+	void finish()
+	{
+		if (pending_size == 0) {
+			return;
+		}
+		const uint32_t bits = (uint32_t)pending[0] << 16 |
+				      (pending_size > 1 ? (uint32_t)pending[1] << 8 : 0);
+		output += alphabet[(bits >> 18) & 0x3f];
+		output += alphabet[(bits >> 12) & 0x3f];
+		output += pending_size > 1 ? alphabet[(bits >> 6) & 0x3f] : '=';
+		output += '=';
+		pending_size = 0;
 	}
-	if (tf->stagesurface) {
-		gs_stagesurface_destroy(tf->stagesurface);
-		tf->stagesurface = nullptr;
+
+protected:
+	qint64 readData(char *data, qint64 maxSize) override
+	{
+		UNUSED_PARAMETER(data);
+		UNUSED_PARAMETER(maxSize);
+		return -1;
 	}
-}
 
-/**
-  * @brief Get RGBA from the stage surface
-  *
-  * @param tf  The filter data
-  * @param width  The width of the stage surface (output)
-  * @param height  The height of the stage surface (output)
-  * @param scale  Scale the output by this factor
-  * @return The RGBA buffer (4 bytes per pixel) or an empty vector if there was an error
-*/
-std::vector<uint8_t> get_rgba_from_source_render(obs_source_t *source, source_render_data *tf,
-						 uint32_t &width, uint32_t &height, float scale)
-{
-	if (!obs_source_enabled(source)) {
-		obs_log(LOG_ERROR, "Source is not enabled");
-		return std::vector<uint8_t>();
+	qint64 writeData(const char *data, qint64 size) override
+	{
+		const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+		qint64 i = 0;
+		// complete the group left over from the last write
+		while (pending_size > 0 && pending_size < 3 && i < size) {
+			pending[pending_size++] = bytes[i++];
+		}
+		if (pending_size == 3) {
+			encode_group(pending);
+			pending_size = 0;
+		}
+		for (; i + 3 <= size; i += 3) {
+			encode_group(bytes + i);
+		}
+		while (i < size) {
+			pending[pending_size++] = bytes[i++];
+		}
+		return size;
 	}
 
-	width = obs_source_get_base_width(source);
-	height = obs_source_get_base_height(source);
-	if (width == 0 || height == 0) {
-		obs_log(LOG_ERROR, "Width or height is 0");
-		return std::vector<uint8_t>();
+private:
+	static constexpr const char *alphabet =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	void encode_group(const uint8_t *group)
+	{
+		const uint32_t bits = (uint32_t)group[0] << 16 | (uint32_t)group[1] << 8 | group[2];
+		output += alphabet[(bits >> 18) & 0x3f];
+		output += alphabet[(bits >> 12) & 0x3f];
+		output += alphabet[(bits >> 6) & 0x3f];
+		output += alphabet[bits & 0x3f];
 	}
-	// scale the width and height
-	width = (uint32_t)((float)width * scale);
-	height = (uint32_t)((float)height * scale);
 
-	// enter graphics context
-	obs_enter_graphics();
+	std::string &output;
+	uint8_t pending[3] = {0, 0, 0};
+	int pending_size = 0;
+};
 
-	gs_texrender_reset(tf->texrender);
-	if (!gs_texrender_begin(tf->texrender, width, height)) {
-		obs_log(LOG_ERROR, "Could not begin texrender");
-		return std::vector<uint8_t>();
-	}
-	struct vec4 background;
-	vec4_zero(&background);
-	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-	gs_ortho(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height), -100.0f,
-		 100.0f);
-	gs_blend_state_push();
-	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-	obs_source_video_render(source);
-	gs_blend_state_pop();
-	gs_texrender_end(tf->texrender);
-
-	if (tf->stagesurface) {
-		uint32_t stagesurf_width = gs_stagesurface_get_width(tf->stagesurface);
-		uint32_t stagesurf_height = gs_stagesurface_get_height(tf->stagesurface);
-		if (stagesurf_width != width || stagesurf_height != height) {
-			gs_stagesurface_destroy(tf->stagesurface);
-			tf->stagesurface = nullptr;
+bool has_webp_writer()
+{
+	static const bool supported = QImageWriter::supportedImageFormats().contains("webp");
+	return supported;
+}
+
+} // namespace
+
+std::string convert_rgba_buffer_to_base64(const std::vector<uint8_t> &rgba, uint32_t width,
+					  uint32_t height, const std::string &format, int quality,
+					  std::string &mime_type)
+{
+	const char *qt_format = "PNG";
+	mime_type = "image/png";
+	if (format == "WebP" && has_webp_writer()) {
+		qt_format = "WEBP";
+		mime_type = "image/webp";
+	} else if (format == "JPEG" || format == "WebP") {
+		if (format == "WebP") {
+			obs_log(LOG_WARNING, "WebP encoding isn't available, using JPEG");
 		}
+		qt_format = "JPG";
+		mime_type = "image/jpeg";
 	}
-	if (!tf->stagesurface) {
-		tf->stagesurface = gs_stagesurface_create(width, height, GS_BGRA);
+	// JPEG has no alpha channel, read the pixels as RGBX so Qt doesn't convert the image
+	QImage image(rgba.data(), (int)width, (int)height, (qsizetype)width * 4,
+		     strcmp(qt_format, "JPG") == 0 ? QImage::Format_RGBX8888
+						   : QImage::Format_RGBA8888);
+
+	// the encoder writes straight into the base64 string. Base64 never needs JSON escaping.
+	std::string base64;
+	Base64Writer writer(base64);
+	writer.open(QIODevice::WriteOnly);
+	// quality is ignored for PNG
+	if (!image.save(&writer, qt_format, strcmp(qt_format, "PNG") == 0 ? -1 : quality)) {
+		obs_log(LOG_ERROR, "Failed to encode the image as %s", qt_format);
+		return std::string();
 	}
-	gs_stage_texture(tf->stagesurface, gs_texrender_get_texture(tf->texrender));
-	uint8_t *video_data;
-	uint32_t linesize;
-	if (!gs_stagesurface_map(tf->stagesurface, &video_data, &linesize)) {
-		obs_log(LOG_ERROR, "Cannot map stage surface");
+	writer.finish();
+	writer.close();
+	return base64;
+}
+
+std::vector<uint8_t> compute_image_thumbnail(const std::vector<uint8_t> &rgba, uint32_t width,
+					     uint32_t height)
+{
+	// 32x32 cells, or fewer for tiny images
+	const uint32_t grid_width = std::min(width, 32u);
+	const uint32_t grid_height = std::min(height, 32u);
+	if (grid_width == 0 || grid_height == 0 || rgba.size() < (size_t)width * height * 4) {
 		return std::vector<uint8_t>();
 	}
-	obs_log(LOG_INFO, "linesize: %d, width: %d, height: %d", linesize, width, height);
-	if (linesize != width * 4) {
-		obs_log(LOG_WARNING, "linesize %d != width %d * 4", linesize, width);
-	}
-	std::vector<uint8_t> rgba(width * height * 4);
-	for (uint32_t i = 0; i < height; i++) {
-		memcpy(rgba.data() + i * width * 4, video_data + i * linesize, width * 4);
-	}
-
-	gs_stagesurface_unmap(tf->stagesurface);
 
-	// leave graphics context
-	obs_leave_graphics();
+	std::vector<uint32_t> sums(grid_width * grid_height, 0);
+	std::vector<uint32_t> counts(grid_width * grid_height, 0);
+	for (uint32_t y = 0; y < height; y++) {
+		const uint32_t row = y * grid_height / height * grid_width;
+		const uint8_t *pixel = rgba.data() + (size_t)y * width * 4;
+		for (uint32_t x = 0; x < width; x++, pixel += 4) {
+			const uint32_t cell = row + x * grid_width / width;
+			// integer Rec. 601 luma
+			sums[cell] += (77u * pixel[0] + 150u * pixel[1] + 29u * pixel[2]) >> 8;
+			counts[cell]++;
+		}
+	}
 
-	return rgba;
+	std::vector<uint8_t> thumbnail(sums.size());
+	for (size_t i = 0; i < sums.size(); i++) {
+		thumbnail[i] = (uint8_t)(sums[i] / std::max(counts[i], 1u));
+	}
+	return thumbnail;
 }
 
-std::string convert_rgba_buffer_to_png_base64(const std::vector<uint8_t> &rgba, uint32_t width,
-					      uint32_t height)
+float image_thumbnail_difference(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
 {
-	// use Qt to convert the RGBA buffer to an encoded image buffer
-	QImage image(rgba.data(), width, height, QImage::Format_RGBA8888);
-	QByteArray ba;
-	QBuffer buffer(&ba);
-	buffer.open(QIODevice::WriteOnly);
-	image.save(&buffer, "PNG");
-	buffer.close();
-
-	// convert the encoded image buffer to a base64 string
-	QByteArray base64 = ba.toBase64();
-	std::string base64_str = base64.toStdString();
-
-	// json string escape
-	nlohmann::json j(base64_str);
-	std::string escaped = j.dump();
-	// remove the quotes
-	escaped = escaped.substr(1, escaped.size() - 2);
-
-	return escaped;
+	if (a.empty() || a.size() != b.size()) {
+		return 100.0f;
+	}
+	// a local change (e.g. a caption) moves a few cells a lot, noise moves all of them a little
+	const int noise_tolerance = 4;
+	size_t changed = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (std::abs((int)a[i] - (int)b[i]) > noise_tolerance) {
+			changed++;
+		}
+	}
+	return (float)changed * 100.0f / (float)a.size();
 }
 
 std::string get_source_name_without_prefix(const std::string &source_name)
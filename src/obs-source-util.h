@@ -27,19 +27,29 @@ inline bool is_obs_source_text(const std::string &source_name)
 	return false;
 }
 
-struct source_render_data {
-	gs_texrender_t *texrender;
-	gs_stagesurf_t *stagesurface;
-};
-
-void init_source_render_data(source_render_data *tf);
-void destroy_source_render_data(source_render_data *tf);
-
-std::vector<uint8_t> get_rgba_from_source_render(obs_source_t *source, source_render_data *tf,
-						 uint32_t &width, uint32_t &height, float scale);
-
-std::string convert_rgba_buffer_to_png_base64(const std::vector<uint8_t> &rgba, uint32_t width,
-					      uint32_t height);
+/**
+  * Encode an RGBA buffer as an image, base64 encoded.
+  * @param format "PNG", "JPEG" or "WebP" (JPEG if Qt can't write WebP)
+  * @param quality 0-100, for JPEG and WebP
+  * @param mime_type set to the MIME type of the encoded image
+  * @return the base64 text or an empty string if encoding failed
+  */
+std::string convert_rgba_buffer_to_base64(const std::vector<uint8_t> &rgba, uint32_t width,
+					  uint32_t height, const std::string &format, int quality,
+					  std::string &mime_type);
+
+/**
+  * Downsample an RGBA image to a small grayscale thumbnail (the average luma of each cell of
+  * a grid over the image) to cheaply tell if the image changed.
+  */
+std::vector<uint8_t> compute_image_thumbnail(const std::vector<uint8_t> &rgba, uint32_t width,
+					     uint32_t height);
+
+/**
+  * Difference between two thumbnails from compute_image_thumbnail: the percentage of cells
+  * whose luma changed by more than a little noise. 100 if the thumbnails can't be compared.
+  */
+float image_thumbnail_difference(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b);
 
 inline bool is_valid_output_source_name(const char *output_source_name)
 {
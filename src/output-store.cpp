@@ -0,0 +1,73 @@
+#include "output-store.h"
+#include "url-source-data.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <nlohmann/json.hpp>
+
+// void get_output(in string mapping, out string output)
+// Get the last output of a mapping, or of the first stored mapping if no name is given
+void output_store_get_output(void *data, calldata_t *cd)
+{
+	struct url_source_data *usd = static_cast<struct url_source_data *>(data);
+	const char *mapping_name = calldata_string(cd, "mapping");
+
+	std::lock_guard<std::mutex> lock(usd->output_store.mutex);
+	std::string output;
+	if (mapping_name != nullptr && mapping_name[0] != '\0') {
+		auto it = usd->output_store.outputs.find(mapping_name);
+		if (it != usd->output_store.outputs.end()) {
+			output = it->second;
+		}
+	} else if (!usd->output_store.outputs.empty()) {
+		output = usd->output_store.outputs.begin()->second;
+	}
+	calldata_set_string(cd, "output", output.c_str());
+}
+
+// void get_outputs(out string outputs)
+// Get all stored outputs as a JSON object of mapping name -> text
+void output_store_get_outputs(void *data, calldata_t *cd)
+{
+	struct url_source_data *usd = static_cast<struct url_source_data *>(data);
+
+	nlohmann::json outputs = nlohmann::json::object();
+	{
+		std::lock_guard<std::mutex> lock(usd->output_store.mutex);
+		for (const auto &output : usd->output_store.outputs) {
+			outputs[output.first] = output.second;
+		}
+	}
+	calldata_set_string(cd, "outputs", outputs.dump().c_str());
+}
+
+void output_store_register(struct url_source_data *usd)
+{
+	signal_handler_t *sh = obs_source_get_signal_handler(usd->source);
+	signal_handler_add(sh, "void output_changed(ptr source, string mapping, string output)");
+
+	proc_handler_t *ph = obs_source_get_proc_handler(usd->source);
+	proc_handler_add(ph, "void get_output(in string mapping, out string output)",
+			 output_store_get_output, usd);
+	proc_handler_add(ph, "void get_outputs(out string outputs)", output_store_get_outputs,
+			 usd);
+}
+
+void output_store_publish(struct url_source_data *usd, const std::string &mapping_name,
+			  const std::string &text)
+{
+	{
+		std::lock_guard<std::mutex> lock(usd->output_store.mutex);
+		usd->output_store.outputs[mapping_name] = text;
+	}
+
+	// let subscribers know, without going through the source settings
+	calldata_t cd;
+	calldata_init(&cd);
+	calldata_set_ptr(&cd, "source", usd->source);
+	calldata_set_string(&cd, "mapping", mapping_name.c_str());
+	calldata_set_string(&cd, "output", text.c_str());
+	signal_handler_signal(obs_source_get_signal_handler(usd->source), "output_changed", &cd);
+	calldata_free(&cd);
+}
@@ -0,0 +1,16 @@
+#ifndef OUTPUT_STORE_H
+#define OUTPUT_STORE_H
+
+#include <string>
+
+struct url_source_data;
+
+// Register the "output_changed" signal and the get_output/get_outputs procs on the source
+void output_store_register(struct url_source_data *usd);
+
+// Store the text of a "Publish to output channel" mapping and emit "output_changed".
+// Doesn't touch the source settings.
+void output_store_publish(struct url_source_data *usd, const std::string &mapping_name,
+			  const std::string &text);
+
+#endif // OUTPUT_STORE_H
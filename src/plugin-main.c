@@ -19,6 +19,13 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <plugin-support.h>
 
+#include "source-ref-cache.h"
+#include "source-capture.h"
+#include "file-writer.h"
+#include "shm-output.h"
+#include "render-worker.h"
+#include "ui/glyph-atlas.h"
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
 
@@ -27,11 +34,18 @@ extern struct obs_source_info url_source;
 bool obs_module_load(void)
 {
 	obs_log(LOG_INFO, "plugin loaded successfully (version %s)", PLUGIN_VERSION);
+	source_ref_cache_init();
 	obs_register_source(&url_source);
 	return true;
 }
 
 void obs_module_unload(void)
 {
+	glyph_atlas_free();
+	render_worker_stop();
+	file_writer_stop();
+	shm_output_free();
+	source_capture_free();
+	source_ref_cache_free();
 	obs_log(LOG_INFO, "plugin unloaded");
 }
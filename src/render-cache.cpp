@@ -0,0 +1,54 @@
+#include "render-cache.h"
+
+#include <util/bmem.h>
+
+namespace {
+
+// a few frames, enough for several internal rendering mappings or a short ticker rotation
+const size_t render_cache_max_entries = 8;
+
+} // namespace
+
+url_source_render_cache::~url_source_render_cache()
+{
+	for (auto &entry : entries) {
+		bfree(entry.buffer.data);
+	}
+}
+
+render_cache_entry *render_cache_find(url_source_render_cache &cache, const std::string &text,
+				      const std::string &css_props, uint32_t requested_width)
+{
+	for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+		if (it->requested_width == requested_width && it->text == text &&
+		    it->css_props == css_props) {
+			// move to the front, the list nodes (and pointers to them) stay valid
+			cache.entries.splice(cache.entries.begin(), cache.entries, it);
+			return &cache.entries.front();
+		}
+	}
+	return nullptr;
+}
+
+render_cache_entry &render_cache_insert(url_source_render_cache &cache, const std::string &text,
+					const std::string &css_props, uint32_t requested_width,
+					frame_buffer &buffer, uint32_t width, uint32_t height)
+{
+	while (cache.entries.size() >= render_cache_max_entries) {
+		render_cache_entry &oldest = cache.entries.back();
+		frame_buffer_pool_release(cache.pool, oldest.buffer);
+		cache.entries.pop_back();
+	}
+
+	cache.entries.emplace_front();
+	render_cache_entry &entry = cache.entries.front();
+	entry.id = cache.next_id++;
+	entry.text = text;
+	entry.css_props = css_props;
+	entry.requested_width = requested_width;
+	entry.buffer = buffer;
+	buffer = frame_buffer();
+	entry.width = width;
+	entry.height = height;
+	return entry;
+}
@@ -0,0 +1,47 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include "frame-buffer-pool.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+// A rendered frame (BGRA) and what it was rendered from
+struct render_cache_entry {
+	// unique in the cache, never reused
+	uint64_t id = 0;
+	std::string text;
+	std::string css_props;
+	uint32_t requested_width = 0;
+	frame_buffer buffer;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Recently rendered frames of a source, so identical text isn't laid out and rasterized again.
+// Only accessed from the curl thread.
+struct url_source_render_cache {
+	// buffers of evicted frames, reused for new renders
+	frame_buffer_pool pool;
+	// most recently used first
+	std::list<render_cache_entry> entries;
+	uint64_t next_id = 1;
+
+	url_source_render_cache() = default;
+	url_source_render_cache(const url_source_render_cache &) = delete;
+	url_source_render_cache &operator=(const url_source_render_cache &) = delete;
+	~url_source_render_cache();
+};
+
+// Find a frame rendered from this text, CSS and width. Returns nullptr on a miss.
+render_cache_entry *render_cache_find(url_source_render_cache &cache, const std::string &text,
+				      const std::string &css_props, uint32_t requested_width);
+
+// Add a rendered frame to the cache, which takes ownership of the buffer (from cache.pool).
+// Evicts the least recently used frame, returning its buffer to the pool, when the cache is full.
+render_cache_entry &render_cache_insert(url_source_render_cache &cache, const std::string &text,
+					const std::string &css_props, uint32_t requested_width,
+					frame_buffer &buffer, uint32_t width, uint32_t height);
+
+#endif // RENDER_CACHE_H
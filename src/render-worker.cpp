@@ -0,0 +1,73 @@
+#include "render-worker.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+std::mutex worker_mutex;
+std::condition_variable worker_cv;
+std::thread worker_thread;
+bool worker_running = false;
+// (priority, submission order) -> job, so the first job is the next one to run
+std::map<std::pair<int, uint64_t>, std::packaged_task<void()>> render_jobs;
+uint64_t next_job_order = 0;
+
+void worker_loop()
+{
+	std::unique_lock<std::mutex> lock(worker_mutex);
+	while (true) {
+		worker_cv.wait(lock, [] { return !render_jobs.empty() || !worker_running; });
+		if (render_jobs.empty()) {
+			// stopped and all jobs are done
+			break;
+		}
+
+		auto next = render_jobs.begin();
+		std::packaged_task<void()> task = std::move(next->second);
+		render_jobs.erase(next);
+		lock.unlock();
+
+		task();
+
+		lock.lock();
+	}
+}
+
+} // namespace
+
+std::future<void> render_worker_submit(render_priority priority, std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	std::future<void> result = task.get_future();
+
+	std::lock_guard<std::mutex> lock(worker_mutex);
+	if (!worker_running) {
+		if (worker_thread.joinable()) {
+			worker_thread.join();
+		}
+		worker_running = true;
+		worker_thread = std::thread(worker_loop);
+	}
+	render_jobs.emplace(std::make_pair((int)priority, next_job_order++), std::move(task));
+	worker_cv.notify_one();
+	return result;
+}
+
+void render_worker_stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(worker_mutex);
+		worker_running = false;
+	}
+	worker_cv.notify_all();
+	if (worker_thread.joinable()) {
+		worker_thread.join();
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Finish the queued render jobs and stop the render thread. Called on module unload.
+void render_worker_stop(void);
+
+#ifdef __cplusplus
+}
+
+#include <functional>
+#include <future>
+
+// Render jobs of sources that are on screen go before those of hidden sources
+// (e.g. sources set to run while not visible)
+enum render_priority {
+	RENDER_PRIORITY_VISIBLE = 0,
+	RENDER_PRIORITY_HIDDEN = 1,
+};
+
+/**
+  * Queue a render job on the plugin-wide render thread, which does all the Qt text layout and
+  * rasterization of all sources. Jobs run one at a time, by priority and then in order.
+  * @return a future that is ready when the job is done (and rethrows its exception, if any)
+  */
+std::future<void> render_worker_submit(render_priority priority, std::function<void()> job);
+
+#endif
+
+#endif // RENDER_WORKER_H
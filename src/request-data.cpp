@@ -1,6 +1,5 @@
-#include <inja/inja.hpp>
-
 #include "request-data.h"
+#include "template-cache.h"
 #include "plugin-support.h"
 #include "parsers/parsers.h"
 #include "string-util.h"
@@ -24,6 +23,8 @@
 #include <obs-module.h>
 
 #include "obs-source-util.h"
+#include "source-ref-cache.h"
+#include "source-capture.h"
 #include "websocket-client.h"
 
 #define URL_SOURCE_AGG_BUFFER_MAX_SIZE 1024
@@ -44,6 +45,33 @@ std::size_t writeFunctionUint8Vector(void *ptr, std::size_t size, size_t nmemb,
 	return size * nmemb;
 }
 
+// Response body that is also handed to a stream callback while it downloads
+struct streamed_body {
+	std::vector<uint8_t> data;
+	const request_body_stream *stream;
+	CURL *curl;
+	// checked on the first write: only the body of a 2xx response is streamed
+	bool checked_status = false;
+	bool is_success = false;
+};
+
+std::size_t writeFunctionStreamedBody(void *ptr, std::size_t size, size_t nmemb,
+				      streamed_body *body)
+{
+	const uint8_t *bytes = static_cast<uint8_t *>(ptr);
+	body->data.insert(body->data.end(), bytes, bytes + size * nmemb);
+	if (!body->checked_status) {
+		long http_code = 0;
+		curl_easy_getinfo(body->curl, CURLINFO_RESPONSE_CODE, &http_code);
+		body->is_success = http_code >= 200 && http_code < 300;
+		body->checked_status = true;
+	}
+	if (body->is_success) {
+		(*body->stream)(bytes, size * nmemb);
+	}
+	return size * nmemb;
+}
+
 bool hasOnlyValidURLCharacters(const std::string &url)
 {
 	// This pattern allows typical URL characters including percent encoding
@@ -179,20 +207,18 @@ void put_inputs_on_json(url_source_request_data *request_data,
 
 		// remove the prefix from the source name
 		std::string source_name = get_source_name_without_prefix(input.source);
-		// Check if the source is a text source
-		if (is_obs_source_text(source_name)) {
-			obs_source_t *source = obs_get_source_by_name(source_name.c_str());
+		// Get the source once (through the ref cache) and check if it's a text source
+		obs_source_t *source = get_cached_source_by_name(source_name);
+		if (is_obs_source_text(source)) {
 			std::string textStr;
-			if (source) {
-				// Get text from OBS text source
-				obs_data_t *sourceSettings = obs_source_get_settings(source);
-				const char *text = obs_data_get_string(sourceSettings, "text");
-				obs_data_release(sourceSettings);
-				obs_source_release(source);
-				if (text != NULL) {
-					textStr = text;
-				}
+			// Get text from OBS text source
+			obs_data_t *sourceSettings = obs_source_get_settings(source);
+			const char *text = obs_data_get_string(sourceSettings, "text");
+			if (text != NULL) {
+				textStr = text;
 			}
+			obs_data_release(sourceSettings);
+			obs_source_release(source);
 
 			if (textStr.empty()) {
 				handle_empty_text(input, response, json);
@@ -231,7 +257,6 @@ void put_inputs_on_json(url_source_request_data *request_data,
 		} else {
 			// this is not a text source.
 			// we should grab an image of its output, encode it to base64 and use it as input
-			obs_source_t *source = obs_get_source_by_name(source_name.c_str());
 			if (source == NULL) {
 				obs_log(LOG_INFO, "Failed to get source by name");
 				// Return an error response
@@ -240,9 +265,6 @@ void put_inputs_on_json(url_source_request_data *request_data,
 				return;
 			}
 
-			// render the source to an image using get_rgba_from_source_render
-			source_render_data tf;
-			init_source_render_data(&tf);
 			// get the scale factor from the request_data->obs_input_source_resize_option
 			float scale = 1.0;
 			if (input.resize_method != "100%") {
@@ -255,7 +277,8 @@ void put_inputs_on_json(url_source_request_data *request_data,
 
 			uint32_t width, height;
 			std::vector<uint8_t> rgba =
-				get_rgba_from_source_render(source, &tf, width, height, scale);
+				get_rgba_from_source_render(source, width, height, scale);
+			obs_source_release(source);
 			if (rgba.empty()) {
 				obs_log(LOG_INFO, "Failed to get RGBA from source render");
 				// Return an error response
@@ -263,19 +286,44 @@ void put_inputs_on_json(url_source_request_data *request_data,
 				response.status_code = URL_SOURCE_REQUEST_STANDARD_ERROR_CODE;
 				return;
 			}
-			destroy_source_render_data(&tf);
+
+			if (input.no_same) {
+				// skip encoding and the request if the image barely changed since
+				// it was last sent
+				std::vector<uint8_t> thumbnail =
+					compute_image_thumbnail(rgba, width, height);
+				if (image_thumbnail_difference(thumbnail,
+							       input.last_image_thumbnail) <=
+				    input.image_change_threshold) {
+					response.error_message =
+						"Input image is the same as last time, skipping was requested";
+					response.status_code = URL_SOURCE_REQUEST_BENIGN_ERROR_CODE;
+					return;
+				}
+				// a failed request doesn't count as sent, see curl_loop
+				input.pending_image_thumbnail = std::move(thumbnail);
+			}
 
 			// encode the image to base64
-			std::string base64 = convert_rgba_buffer_to_png_base64(rgba, width, height);
+			std::string mime_type;
+			std::string base64 = convert_rgba_buffer_to_base64(
+				rgba, width, height, input.image_format, input.image_quality,
+				mime_type);
+			if (base64.empty()) {
+				response.error_message = "Failed to encode the input image";
+				response.status_code = URL_SOURCE_REQUEST_STANDARD_ERROR_CODE;
+				return;
+			}
 
-			// set the input to the base64 encoded image
-			json["imageb64"] = base64;
+			// set the input to the base64 encoded image, and its type for data URLs
+			json["imageb64"] = std::move(base64);
+			json["imagemime"] = mime_type;
 		} // end of non-text source
 	}
 }
 
-void prepare_inja_env(inja::Environment *env, url_source_request_data *request_data,
-		      request_data_handler_response &response, nlohmann::json &json)
+void prepare_inja_data(url_source_request_data *request_data,
+		       request_data_handler_response &response, nlohmann::json &json)
 {
 	// Put the request inputs on the json object
 	put_inputs_on_json(request_data, response, json);
@@ -284,25 +332,13 @@ void prepare_inja_env(inja::Environment *env, url_source_request_data *request_d
 		return;
 	}
 
-	// Add an inja callback for time formatting
-	env->add_callback("strftime", 2, [](inja::Arguments &args) {
-		std::string format = args.at(0)->get<std::string>();
-		std::time_t t = std::time(nullptr);
-		std::tm *tm = std::localtime(&t);
-		if (args.at(1)->get<bool>()) {
-			// if the second argument is true, use UTC time
-			tm = std::gmtime(&t);
-		}
-		char buffer[256];
-		std::strftime(buffer, sizeof(buffer), format.c_str(), tm);
-		return std::string(buffer);
-	});
-
 	json["seq"] = request_data->sequence_number;
 }
 
 request_data_handler_response http_request_handler(url_source_request_data *request_data,
-						   request_data_handler_response &response)
+						   url_source_template_cache *templates,
+						   request_data_handler_response &response,
+						   const request_body_stream &body_stream)
 {
 	// Build the request with libcurl
 	CURL *curl = curl_easy_init();
@@ -319,7 +355,7 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	}
 
 	std::string responseBody;
-	std::vector<uint8_t> responseBodyUint8;
+	streamed_body responseBodyUint8 = {{}, &body_stream, curl};
 
 	// if the request is for textual data write to string
 	if (request_data->output_type == "JSON" || request_data->output_type == "XML (XPath)" ||
@@ -327,8 +363,11 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	    request_data->output_type == "Text") {
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBody);
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunctionStdString);
-	} else {
+	} else if (body_stream) {
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBodyUint8);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunctionStreamedBody);
+	} else {
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBodyUint8.data);
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunctionUint8Vector);
 	}
 
@@ -343,27 +382,17 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	}
 
 	nlohmann::json json; // json object or variables for inja
-	inja::Environment env;
-	prepare_inja_env(&env, request_data, response, json);
+	prepare_inja_data(request_data, response, json);
 
 	if (response.status_code != URL_SOURCE_REQUEST_SUCCESS) {
 		curl_easy_cleanup(curl);
 		return response;
 	}
 
-	// add a callback for escaping strings in the querystring
-	env.add_callback("urlencode", 1, [&curl](inja::Arguments &args) {
-		std::string input = args.at(0)->get<std::string>();
-		char *escaped = curl_easy_escape(curl, input.c_str(), 0);
-		input = std::string(escaped);
-		curl_free(escaped);
-		return input;
-	});
-
 	// Replace the {input} placeholder in the querystring as well
 	std::string url = request_data->url;
 	try {
-		url = env.render(url, json);
+		url = render_cached_template(*templates, templates->url, request_data->url, json);
 	} catch (std::exception &e) {
 		obs_log(LOG_WARNING, "Failed to render URL template: %s", e.what());
 	}
@@ -386,7 +415,8 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	if (request_data->method == "POST") {
 		curl_easy_setopt(curl, CURLOPT_POST, 1L);
 		try {
-			request_body_allocated = env.render(request_data->body, json);
+			request_body_allocated = render_cached_template(
+				*templates, templates->body, request_data->body, json);
 		} catch (std::exception &e) {
 			obs_log(LOG_WARNING, "Failed to render Body template: %s", e.what());
 		}
@@ -422,7 +452,7 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	curl_easy_cleanup(curl);
 
 	response.body = responseBody;
-	response.body_bytes = responseBodyUint8;
+	response.body_bytes = std::move(responseBodyUint8.data);
 	response.headers = headers;
 	response.http_status_code = http_code;
 
@@ -445,7 +475,9 @@ request_data_handler_response http_request_handler(url_source_request_data *requ
 	return response;
 }
 
-struct request_data_handler_response request_data_handler(url_source_request_data *request_data)
+struct request_data_handler_response request_data_handler(url_source_request_data *request_data,
+							  url_source_template_cache *templates,
+							  const request_body_stream &body_stream)
 {
 	struct request_data_handler_response response;
 
@@ -481,10 +513,11 @@ struct request_data_handler_response request_data_handler(url_source_request_dat
 		// This is a URL request
 		if (request_data->method == "WebSocket") {
 			// This is a websocket request
-			response = websocket_request_handler(request_data);
+			response = websocket_request_handler(request_data, templates);
 		} else {
 			// This is an HTTP request
-			response = http_request_handler(request_data, response);
+			response = http_request_handler(request_data, templates, response,
+							body_stream);
 		}
 
 		if (response.status_code != URL_SOURCE_REQUEST_SUCCESS) {
@@ -691,7 +724,7 @@ bool isURL(const std::string &str)
 }
 
 // Fetch image from url and get bytes
-std::vector<uint8_t> fetch_image(std::string url, std::string &mime_type)
+std::vector<uint8_t> fetch_image(std::string url, std::string &mime_type, long timeout_ms)
 {
 	// Check if the "url" is actually a file path
 	if (isURL(url) == false) {
@@ -746,6 +779,9 @@ std::vector<uint8_t> fetch_image(std::string url, std::string &mime_type)
 	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
 	curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT.c_str());
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunctionUint8Vector);
+	if (timeout_ms > 0) {
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+	}
 
 	std::vector<uint8_t> responseBody;
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBody);
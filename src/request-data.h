@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <chrono>
+#include <functional>
 
 #include <nlohmann/json.hpp>
 
@@ -170,21 +171,25 @@ struct request_data_handler_response {
 	std::string request_body;
 };
 
-namespace inja {
-class Environment;
-}
+struct url_source_template_cache; // Forward declaration
+
+void prepare_inja_data(url_source_request_data *request_data,
+		       request_data_handler_response &response, nlohmann::json &json);
 
-void prepare_inja_env(inja::Environment *env, url_source_request_data *request_data,
-		      request_data_handler_response &response, nlohmann::json &json);
+// Receives the bytes of a binary response body while it downloads, only for 2xx responses
+using request_body_stream = std::function<void(const uint8_t *data, size_t size)>;
 
-struct request_data_handler_response request_data_handler(url_source_request_data *request_data);
+struct request_data_handler_response
+request_data_handler(url_source_request_data *request_data, url_source_template_cache *templates,
+		     const request_body_stream &body_stream = nullptr);
 
 std::string serialize_request_data(url_source_request_data *request_data);
 
 url_source_request_data unserialize_request_data(std::string serialized_request_data);
 
-// Fetch image from url and get bytes
-std::vector<uint8_t> fetch_image(std::string url, std::string &out_mime_type);
+// Fetch image from url and get bytes, optionally giving up after timeout_ms
+std::vector<uint8_t> fetch_image(std::string url, std::string &out_mime_type,
+				 long timeout_ms = 0);
 
 // encode bytes to base64
 std::string base64_encode(const std::vector<uint8_t> &bytes);
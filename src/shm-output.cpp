@@ -0,0 +1,169 @@
+#include "shm-output.h"
+#include "url-source-shm.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct shm_output {
+	url_source_shm_header *header = nullptr;
+#ifdef _WIN32
+	HANDLE mapping = nullptr;
+#endif
+};
+
+std::mutex shm_outputs_mutex;
+std::map<std::string, shm_output> shm_outputs;
+
+url_source_shm_header *map_shm_output(const std::string &name, shm_output &output)
+{
+	const size_t size = sizeof(url_source_shm_header);
+#ifdef _WIN32
+	const std::string mapping_name = "Local\\" + name.substr(1);
+	output.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+					    (DWORD)size, mapping_name.c_str());
+	if (output.mapping == nullptr) {
+		obs_log(LOG_ERROR, "Failed to create shared memory '%s'", mapping_name.c_str());
+		return nullptr;
+	}
+	void *memory = MapViewOfFile(output.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (memory == nullptr) {
+		obs_log(LOG_ERROR, "Failed to map shared memory '%s'", mapping_name.c_str());
+		CloseHandle(output.mapping);
+		output.mapping = nullptr;
+		return nullptr;
+	}
+#else
+	const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		obs_log(LOG_ERROR, "Failed to open shared memory '%s'", name.c_str());
+		return nullptr;
+	}
+	if (ftruncate(fd, (off_t)size) != 0) {
+		obs_log(LOG_ERROR, "Failed to size shared memory '%s'", name.c_str());
+		close(fd);
+		return nullptr;
+	}
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		obs_log(LOG_ERROR, "Failed to map shared memory '%s'", name.c_str());
+		return nullptr;
+	}
+#endif
+	url_source_shm_header *header = static_cast<url_source_shm_header *>(memory);
+	if (header->magic == URL_SOURCE_SHM_MAGIC && header->version == URL_SOURCE_SHM_VERSION &&
+	    header->slot_count == URL_SOURCE_SHM_SLOTS &&
+	    header->slot_size == URL_SOURCE_SHM_SLOT_SIZE) {
+		// a ring with this layout exists (e.g. a consumer kept it open), continue its
+		// sequence so readers don't see it go back
+		obs_log(LOG_INFO, "Opened shared memory output '%s'", name.c_str());
+		return header;
+	}
+	memset(header, 0, sizeof(url_source_shm_header));
+	header->magic = URL_SOURCE_SHM_MAGIC;
+	header->version = URL_SOURCE_SHM_VERSION;
+	header->slot_count = URL_SOURCE_SHM_SLOTS;
+	header->slot_size = URL_SOURCE_SHM_SLOT_SIZE;
+	obs_log(LOG_INFO, "Created shared memory output '%s'", name.c_str());
+	return header;
+}
+
+void unmap_shm_output(const std::string &name, shm_output &output)
+{
+	if (output.header == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UNUSED_PARAMETER(name);
+	UnmapViewOfFile(output.header);
+	CloseHandle(output.mapping);
+	output.mapping = nullptr;
+#else
+	munmap(output.header, sizeof(url_source_shm_header));
+	shm_unlink(name.c_str());
+#endif
+	output.header = nullptr;
+}
+
+} // namespace
+
+std::string shm_output_name_for_mapping(const std::string &source_name,
+					const std::string &mapping_name)
+{
+	// FNV-1a of both names, the readable part alone can be the same for different mappings
+	uint32_t hash = 2166136261u;
+	const std::string key = source_name + '\0' + mapping_name;
+	for (char c : key) {
+		hash = (hash ^ (uint8_t)c) * 16777619u;
+	}
+	char suffix[10];
+	snprintf(suffix, sizeof(suffix), "_%08x", hash);
+
+	// POSIX names must start with a slash, and macOS limits them to 31 characters
+	std::string name = "/urlsource_";
+	const size_t readable_size = 31 - strlen(suffix);
+	for (char c : mapping_name) {
+		if (name.size() >= readable_size) {
+			break;
+		}
+		name += std::isalnum((unsigned char)c) ? (char)std::tolower((unsigned char)c) : '_';
+	}
+	return name + suffix;
+}
+
+bool shm_output_publish(const std::string &name, const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(shm_outputs_mutex);
+	shm_output &output = shm_outputs[name];
+	if (output.header == nullptr) {
+		output.header = map_shm_output(name, output);
+		if (output.header == nullptr) {
+			shm_outputs.erase(name);
+			return false;
+		}
+	}
+
+	url_source_shm_header *header = output.header;
+	const uint64_t seq = header->write_sequence + 1;
+	url_source_shm_slot *slot = &header->slots[seq % URL_SOURCE_SHM_SLOTS];
+	const uint32_t size = (uint32_t)std::min<size_t>(text.size(), URL_SOURCE_SHM_SLOT_SIZE);
+	if (size < text.size()) {
+		obs_log(LOG_WARNING, "Output for shared memory '%s' truncated to %u bytes",
+			name.c_str(), size);
+	}
+
+	// sequence lock: odd while writing, even when the message is complete
+	slot->sequence = seq * 2 + 1;
+	URL_SOURCE_SHM_FENCE();
+	memcpy(slot->data, text.data(), size);
+	slot->size = size;
+	URL_SOURCE_SHM_FENCE();
+	slot->sequence = seq * 2;
+	URL_SOURCE_SHM_FENCE();
+	header->write_sequence = seq;
+	return true;
+}
+
+void shm_output_free(void)
+{
+	std::lock_guard<std::mutex> lock(shm_outputs_mutex);
+	for (auto &output : shm_outputs) {
+		unmap_shm_output(output.first, output.second);
+	}
+	shm_outputs.clear();
+}
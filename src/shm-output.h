@@ -0,0 +1,29 @@
+#ifndef SHM_OUTPUT_H
+#define SHM_OUTPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Unmap and remove all shared memory outputs. Called on module unload.
+void shm_output_free(void);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+// Name of the shared memory object a mapping of a source publishes to, e.g.
+// "/urlsource_score_1a2b3c4d". The hash of the source and mapping names keeps the names of
+// different sources and mappings apart after sanitizing and truncating.
+std::string shm_output_name_for_mapping(const std::string &source_name,
+					const std::string &mapping_name);
+
+// Publish a message into the named shared memory ring buffer (see url-source-shm.h for the
+// layout). The buffer is created on first use. Messages longer than a slot are truncated.
+// @return false if the buffer can't be created
+bool shm_output_publish(const std::string &name, const std::string &text);
+
+#endif
+
+#endif // SHM_OUTPUT_H
@@ -0,0 +1,283 @@
+#include "source-capture.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace {
+
+// how long to wait for a fresh frame before settling for the last one read back
+constexpr auto frame_wait_timeout = std::chrono::milliseconds(500);
+// captures that aren't asked for in this long release their render targets
+constexpr uint64_t idle_capture_ns = 10000000000ULL;
+
+struct source_capture {
+	obs_weak_source_t *source = nullptr;
+	float scale = 1.0f;
+
+	// only used on the graphics thread
+	gs_texrender_t *texrender = nullptr;
+	gs_stagesurf_t *stagesurfaces[2] = {nullptr, nullptr};
+	int next_surface = 0;
+	// the stage surface with a copy to read back on the next frame, -1 if none
+	int staged_surface = -1;
+	uint32_t staged_width = 0;
+	uint32_t staged_height = 0;
+	std::vector<uint8_t> readback;
+
+	// guarded by capture_mutex
+	uint64_t requests = 0;
+	uint64_t last_request_ns = 0;
+	// the request the staged copy answers
+	uint64_t staged_request = 0;
+	// the latest frame read back and the last request it answers
+	std::vector<uint8_t> rgba;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t frame_request = 0;
+	bool removed = false;
+};
+
+// lock order: the OBS draw callback mutex (held while render_captures runs), capture_mutex
+std::mutex capture_mutex;
+std::condition_variable capture_cv;
+std::vector<std::shared_ptr<source_capture>> captures;
+
+std::mutex render_callback_mutex;
+bool render_callback_added = false;
+
+// in the graphics context
+void destroy_capture(source_capture &capture)
+{
+	gs_texrender_destroy(capture.texrender);
+	capture.texrender = nullptr;
+	for (gs_stagesurf_t *&surface : capture.stagesurfaces) {
+		if (surface != nullptr) {
+			gs_stagesurface_destroy(surface);
+			surface = nullptr;
+		}
+	}
+	obs_weak_source_release(capture.source);
+	capture.source = nullptr;
+	capture.removed = true;
+}
+
+// Copy out the frame staged on the previous frame, the GPU is done with it by now
+bool read_back_capture(source_capture &capture)
+{
+	if (capture.staged_surface < 0) {
+		return false;
+	}
+	gs_stagesurf_t *surface = capture.stagesurfaces[capture.staged_surface];
+	capture.staged_surface = -1;
+
+	uint8_t *video_data;
+	uint32_t linesize;
+	if (!gs_stagesurface_map(surface, &video_data, &linesize)) {
+		obs_log(LOG_ERROR, "Cannot map stage surface");
+		return false;
+	}
+	const size_t row_size = (size_t)capture.staged_width * 4;
+	capture.readback.resize(row_size * capture.staged_height);
+	for (uint32_t i = 0; i < capture.staged_height; i++) {
+		memcpy(capture.readback.data() + i * row_size, video_data + i * linesize,
+		       row_size);
+	}
+	gs_stagesurface_unmap(surface);
+
+	std::lock_guard<std::mutex> lock(capture_mutex);
+	std::swap(capture.rgba, capture.readback);
+	capture.width = capture.staged_width;
+	capture.height = capture.staged_height;
+	capture.frame_request = capture.staged_request;
+	return true;
+}
+
+// Render the source and copy it to a stage surface if there's a request for a new frame
+void stage_capture(source_capture &capture)
+{
+	uint64_t request;
+	{
+		std::lock_guard<std::mutex> lock(capture_mutex);
+		if (capture.requests <= capture.frame_request) {
+			return;
+		}
+		request = capture.requests;
+	}
+
+	obs_source_t *source = obs_weak_source_get_source(capture.source);
+	if (source == nullptr) {
+		return;
+	}
+	const uint32_t base_width = obs_source_get_base_width(source);
+	const uint32_t base_height = obs_source_get_base_height(source);
+	const uint32_t width = (uint32_t)((float)base_width * capture.scale);
+	const uint32_t height = (uint32_t)((float)base_height * capture.scale);
+	if (width == 0 || height == 0) {
+		obs_source_release(source);
+		return;
+	}
+
+	if (capture.texrender == nullptr) {
+		capture.texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	}
+	gs_texrender_reset(capture.texrender);
+	if (!gs_texrender_begin(capture.texrender, width, height)) {
+		obs_log(LOG_ERROR, "Could not begin texrender");
+		obs_source_release(source);
+		return;
+	}
+	struct vec4 background;
+	vec4_zero(&background);
+	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+	// the source draws at its base size, scaled to the render target
+	gs_ortho(0.0f, (float)base_width, 0.0f, (float)base_height, -100.0f, 100.0f);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	obs_source_video_render(source);
+	gs_blend_state_pop();
+	gs_texrender_end(capture.texrender);
+	obs_source_release(source);
+
+	gs_stagesurf_t *&surface = capture.stagesurfaces[capture.next_surface];
+	if (surface != nullptr && (gs_stagesurface_get_width(surface) != width ||
+				   gs_stagesurface_get_height(surface) != height)) {
+		gs_stagesurface_destroy(surface);
+		surface = nullptr;
+	}
+	if (surface == nullptr) {
+		surface = gs_stagesurface_create(width, height, GS_RGBA);
+	}
+	gs_stage_texture(surface, gs_texrender_get_texture(capture.texrender));
+	capture.staged_surface = capture.next_surface;
+	capture.staged_width = width;
+	capture.staged_height = height;
+	capture.next_surface ^= 1;
+
+	std::lock_guard<std::mutex> lock(capture_mutex);
+	capture.staged_request = request;
+}
+
+// Main render callback, on the graphics thread every frame
+void render_captures(void *param, uint32_t cx, uint32_t cy)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+
+	std::vector<std::shared_ptr<source_capture>> active;
+	{
+		std::lock_guard<std::mutex> lock(capture_mutex);
+		if (captures.empty()) {
+			return;
+		}
+		const uint64_t now = os_gettime_ns();
+		for (auto it = captures.begin(); it != captures.end();) {
+			source_capture &capture = **it;
+			if (capture.requests <= capture.frame_request &&
+			    capture.staged_surface < 0 &&
+			    now - capture.last_request_ns > idle_capture_ns) {
+				destroy_capture(capture);
+				it = captures.erase(it);
+				continue;
+			}
+			active.push_back(*it);
+			++it;
+		}
+	}
+
+	bool read_back = false;
+	for (const auto &capture : active) {
+		// read back the previous frame's copy before staging a new one in the other surface
+		read_back |= read_back_capture(*capture);
+		stage_capture(*capture);
+	}
+	if (read_back) {
+		capture_cv.notify_all();
+	}
+}
+
+} // namespace
+
+std::vector<uint8_t> get_rgba_from_source_render(obs_source_t *source, uint32_t &width,
+						 uint32_t &height, float scale)
+{
+	if (!obs_source_enabled(source)) {
+		obs_log(LOG_ERROR, "Source is not enabled");
+		return std::vector<uint8_t>();
+	}
+	if ((uint32_t)((float)obs_source_get_base_width(source) * scale) == 0 ||
+	    (uint32_t)((float)obs_source_get_base_height(source) * scale) == 0) {
+		obs_log(LOG_ERROR, "Width or height is 0");
+		return std::vector<uint8_t>();
+	}
+
+	{
+		// not under capture_mutex, OBS holds its callback lock while render_captures runs
+		std::lock_guard<std::mutex> lock(render_callback_mutex);
+		if (!render_callback_added) {
+			obs_add_main_render_callback(render_captures, nullptr);
+			render_callback_added = true;
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(capture_mutex);
+	std::shared_ptr<source_capture> capture;
+	for (const auto &existing : captures) {
+		if (existing->scale == scale &&
+		    obs_weak_source_references_source(existing->source, source)) {
+			capture = existing;
+			break;
+		}
+	}
+	if (!capture) {
+		capture = std::make_shared<source_capture>();
+		capture->source = obs_source_get_weak_source(source);
+		capture->scale = scale;
+		captures.push_back(capture);
+	}
+
+	// ask for a frame rendered from now on, it's ready after the next frame or two
+	const uint64_t request = ++capture->requests;
+	capture->last_request_ns = os_gettime_ns();
+	if (!capture_cv.wait_for(lock, frame_wait_timeout, [&] {
+		    return capture->frame_request >= request || capture->removed;
+	    })) {
+		obs_log(LOG_WARNING, "No new frame of the source was rendered in time");
+	}
+	if (capture->rgba.empty()) {
+		return std::vector<uint8_t>();
+	}
+	width = capture->width;
+	height = capture->height;
+	return capture->rgba;
+}
+
+void source_capture_free(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(render_callback_mutex);
+		if (render_callback_added) {
+			obs_remove_main_render_callback(render_captures, nullptr);
+			render_callback_added = false;
+		}
+	}
+
+	obs_enter_graphics();
+	{
+		std::lock_guard<std::mutex> lock(capture_mutex);
+		for (const auto &capture : captures) {
+			destroy_capture(*capture);
+		}
+		captures.clear();
+	}
+	obs_leave_graphics();
+	capture_cv.notify_all();
+}
@@ -0,0 +1,36 @@
+#ifndef SOURCE_CAPTURE_H
+#define SOURCE_CAPTURE_H
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Release the render targets of all captures. Called on module unload.
+void source_capture_free(void);
+
+#ifdef __cplusplus
+}
+
+#include <cstdint>
+#include <vector>
+
+/**
+  * Get an image of a source's output, e.g. to send a non-text input source with a request.
+  * Sources are rendered into persistent render targets on the graphics thread and copied to
+  * one of two stage surfaces, which is read back on the next frame when the GPU is done with
+  * it. So neither this thread nor the graphics thread waits on the GPU, this only waits for
+  * the next frame or two.
+  * Captures that aren't used for a while release their render targets.
+  * @param scale  Scale the output by this factor
+  * @param width  The width of the image (output)
+  * @param height  The height of the image (output)
+  * @return The RGBA buffer (4 bytes per pixel) or an empty vector if there was an error
+  */
+std::vector<uint8_t> get_rgba_from_source_render(obs_source_t *source, uint32_t &width,
+						 uint32_t &height, float scale);
+
+#endif
+
+#endif // SOURCE_CAPTURE_H
@@ -0,0 +1,195 @@
+#include "source-ref-cache.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <map>
+#include <mutex>
+
+namespace {
+
+struct source_ref_entry {
+	obs_weak_source_t *source = nullptr;
+	// the first scene showing the source and the id of the source's item in it
+	obs_weak_source_t *scene = nullptr;
+	int64_t scene_item_id = 0;
+};
+
+std::mutex source_ref_mutex;
+std::map<std::string, source_ref_entry> source_refs;
+
+void release_entry(source_ref_entry &entry)
+{
+	obs_weak_source_release(entry.source);
+	obs_weak_source_release(entry.scene);
+	entry.source = nullptr;
+	entry.scene = nullptr;
+}
+
+void drop_entry(const char *name)
+{
+	if (name == nullptr) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(source_ref_mutex);
+	auto it = source_refs.find(name);
+	if (it != source_refs.end()) {
+		release_entry(it->second);
+		source_refs.erase(it);
+	}
+}
+
+void source_rename_callback(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	drop_entry(calldata_string(cd, "prev_name"));
+}
+
+void source_remove_callback(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	obs_source_t *source = static_cast<obs_source_t *>(calldata_ptr(cd, "source"));
+	if (source == nullptr) {
+		return;
+	}
+	drop_entry(obs_source_get_name(source));
+
+	// forget cached scene items that were in this source, if it's a scene
+	std::lock_guard<std::mutex> lock(source_ref_mutex);
+	for (auto &entry : source_refs) {
+		if (entry.second.scene != nullptr &&
+		    obs_weak_source_references_source(entry.second.scene, source)) {
+			obs_weak_source_release(entry.second.scene);
+			entry.second.scene = nullptr;
+		}
+	}
+}
+
+struct find_scene_item_data {
+	obs_source_t *source;
+	obs_source_t *scene_source;
+	obs_sceneitem_t *scene_item;
+};
+
+bool find_scene_item(void *data, obs_source_t *scene_source)
+{
+	find_scene_item_data *find_data = static_cast<find_scene_item_data *>(data);
+	obs_scene_t *scene = obs_scene_from_source(scene_source);
+	if (scene == nullptr) {
+		return true;
+	}
+	obs_sceneitem_t *scene_item = obs_scene_sceneitem_from_source(scene, find_data->source);
+	if (scene_item == nullptr) {
+		return true;
+	}
+	find_data->scene_item = scene_item;
+	find_data->scene_source = obs_source_get_ref(scene_source);
+	return false; // stop enumerating
+}
+
+} // namespace
+
+void source_ref_cache_init(void)
+{
+	signal_handler_t *sh = obs_get_signal_handler();
+	signal_handler_connect(sh, "source_rename", source_rename_callback, nullptr);
+	signal_handler_connect(sh, "source_remove", source_remove_callback, nullptr);
+}
+
+void source_ref_cache_free(void)
+{
+	signal_handler_t *sh = obs_get_signal_handler();
+	signal_handler_disconnect(sh, "source_rename", source_rename_callback, nullptr);
+	signal_handler_disconnect(sh, "source_remove", source_remove_callback, nullptr);
+
+	std::lock_guard<std::mutex> lock(source_ref_mutex);
+	for (auto &entry : source_refs) {
+		release_entry(entry.second);
+	}
+	source_refs.clear();
+}
+
+obs_source_t *get_cached_source_by_name(const std::string &name)
+{
+	{
+		std::lock_guard<std::mutex> lock(source_ref_mutex);
+		auto it = source_refs.find(name);
+		if (it != source_refs.end()) {
+			obs_source_t *source = obs_weak_source_get_source(it->second.source);
+			if (source != nullptr) {
+				return source;
+			}
+			// the source is gone
+			release_entry(it->second);
+			source_refs.erase(it);
+		}
+	}
+
+	obs_source_t *source = obs_get_source_by_name(name.c_str());
+	if (source == nullptr) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(source_ref_mutex);
+	// don't cache if the source was renamed in the meantime
+	if (name == obs_source_get_name(source)) {
+		source_ref_entry &entry = source_refs[name];
+		if (entry.source == nullptr) {
+			entry.source = obs_source_get_weak_source(source);
+		}
+	}
+	return source;
+}
+
+obs_sceneitem_t *get_cached_scene_item_by_name(const std::string &name,
+					       obs_source_t **scene_source)
+{
+	*scene_source = nullptr;
+	obs_source_t *source = get_cached_source_by_name(name);
+	if (source == nullptr) {
+		return nullptr;
+	}
+
+	obs_sceneitem_t *scene_item = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(source_ref_mutex);
+		auto it = source_refs.find(name);
+		if (it != source_refs.end() && it->second.scene != nullptr) {
+			obs_source_t *scene = obs_weak_source_get_source(it->second.scene);
+			if (scene != nullptr) {
+				scene_item = obs_scene_find_sceneitem_by_id(
+					obs_scene_from_source(scene), it->second.scene_item_id);
+				if (scene_item != nullptr &&
+				    obs_sceneitem_get_source(scene_item) == source) {
+					*scene_source = scene;
+				} else {
+					// the item was removed from the scene
+					scene_item = nullptr;
+					obs_source_release(scene);
+				}
+			}
+		}
+	}
+
+	if (scene_item == nullptr) {
+		// walk the scenes to find the item, then remember where it is
+		find_scene_item_data find_data = {source, nullptr, nullptr};
+		obs_enum_scenes(find_scene_item, &find_data);
+		if (find_data.scene_item != nullptr) {
+			std::lock_guard<std::mutex> lock(source_ref_mutex);
+			auto it = source_refs.find(name);
+			if (it != source_refs.end()) {
+				obs_weak_source_release(it->second.scene);
+				it->second.scene = obs_source_get_weak_source(find_data.scene_source);
+				it->second.scene_item_id = obs_sceneitem_get_id(find_data.scene_item);
+			}
+			// the scene holds the item while the caller holds the scene
+			obs_sceneitem_release(find_data.scene_item);
+			scene_item = find_data.scene_item;
+			*scene_source = find_data.scene_source;
+		}
+	}
+
+	obs_source_release(source);
+	return scene_item;
+}
@@ -0,0 +1,37 @@
+#ifndef SOURCE_REF_CACHE_H
+#define SOURCE_REF_CACHE_H
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connect to the OBS source rename/remove signals. Called on module load/unload.
+void source_ref_cache_init(void);
+void source_ref_cache_free(void);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+/**
+  * Get a source by name through a cache of weak references, so the name lookup is done once
+  * and not on every tick. Entries are dropped when the source is renamed or removed.
+  * @return a strong reference the caller must release, or nullptr if there's no such source
+  */
+obs_source_t *get_cached_source_by_name(const std::string &name);
+
+/**
+  * Get the first scene item showing the source with this name, cached like the source itself.
+  * The scene item reference is only valid while the returned scene source is held.
+  * @param scene_source set to a strong reference of the item's scene, the caller must release
+  * @return the scene item or nullptr if the source isn't in any scene
+  */
+obs_sceneitem_t *get_cached_scene_item_by_name(const std::string &name,
+					       obs_source_t **scene_source);
+
+#endif
+
+#endif // SOURCE_REF_CACHE_H
@@ -0,0 +1,212 @@
+#include "template-cache.h"
+#include "plugin-support.h"
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <set>
+#include <stdexcept>
+
+#include <curl/curl.h>
+#include <obs-module.h>
+
+url_source_template_cache::url_source_template_cache()
+{
+	// Add an inja callback for time formatting
+	env.add_callback("strftime", 2, [](inja::Arguments &args) {
+		std::string format = args.at(0)->get<std::string>();
+		std::time_t t = std::time(nullptr);
+		std::tm *tm = std::localtime(&t);
+		if (args.at(1)->get<bool>()) {
+			// if the second argument is true, use UTC time
+			tm = std::gmtime(&t);
+		}
+		char buffer[256];
+		std::strftime(buffer, sizeof(buffer), format.c_str(), tm);
+		return std::string(buffer);
+	});
+
+	// add a callback for escaping strings in the querystring.
+	// curl_easy_escape doesn't need a curl handle (since 7.82.0) so this can be registered once
+	env.add_callback("urlencode", 1, [](inja::Arguments &args) {
+		std::string input = args.at(0)->get<std::string>();
+		char *escaped = curl_easy_escape(nullptr, input.c_str(), (int)input.size());
+		if (escaped == nullptr) {
+			return std::string();
+		}
+		input = std::string(escaped);
+		curl_free(escaped);
+		return input;
+	});
+}
+
+bool compile_cached_template(url_source_template_cache &cache, url_source_template &tmpl,
+			     const std::string &source)
+{
+	if (tmpl.source != source || (!tmpl.is_compiled && tmpl.parse_error.empty())) {
+		// the template text changed (or was never compiled) - parse it once
+		tmpl.source = source;
+		tmpl.is_compiled = false;
+		tmpl.parse_error.clear();
+		try {
+			tmpl.compiled = cache.env.parse(source);
+			tmpl.is_compiled = true;
+		} catch (std::exception &e) {
+			tmpl.parse_error = e.what();
+			obs_log(LOG_WARNING, "Failed to parse template: %s", e.what());
+		}
+		analyze_template_dependencies(source, tmpl.dependencies, tmpl.always_render);
+	}
+	return tmpl.is_compiled;
+}
+
+std::string render_cached_template(url_source_template_cache &cache, url_source_template &tmpl,
+				   const std::string &source, const nlohmann::json &data)
+{
+	if (!compile_cached_template(cache, tmpl, source)) {
+		throw std::runtime_error(tmpl.parse_error);
+	}
+	return cache.env.render(tmpl.compiled, data);
+}
+
+namespace {
+
+// callbacks whose result isn't a function of the template data alone
+const std::set<std::string> impure_functions = {"strftime"};
+
+// statements that read other template files
+const std::set<std::string> file_statements = {"include", "extends"};
+
+// inja statement keywords and literals - not data references
+const std::set<std::string> template_keywords = {
+	"if",  "else", "elif", "endif", "for", "endfor", "in",   "set",   "block", "endblock",
+	"raw", "endraw", "and", "or",   "not", "true",   "false", "null", "loop"};
+
+bool is_identifier_start(char c)
+{
+	return std::isalpha((unsigned char)c) || c == '_';
+}
+
+bool is_identifier_char(char c)
+{
+	return std::isalnum((unsigned char)c) || c == '_';
+}
+
+// Collect the references in one expression or statement (the text between the delimiters)
+void analyze_expression(const std::string &expr, std::set<std::string> &paths, bool &always_render)
+{
+	size_t i = 0;
+	bool after_pipe = false;
+	while (i < expr.size()) {
+		const char c = expr[i];
+		if (c == '"' || c == '\'') {
+			// skip string literals
+			size_t j = i + 1;
+			while (j < expr.size() && expr[j] != c) {
+				j += (expr[j] == '\\') ? 2 : 1;
+			}
+			i = j + 1;
+			after_pipe = false;
+			continue;
+		}
+		if (std::isdigit((unsigned char)c)) {
+			// skip number literals
+			while (i < expr.size() && (is_identifier_char(expr[i]) || expr[i] == '.')) {
+				i++;
+			}
+			after_pipe = false;
+			continue;
+		}
+		if (!is_identifier_start(c)) {
+			if (c == '|') {
+				after_pipe = true;
+			} else if (!std::isspace((unsigned char)c)) {
+				after_pipe = false;
+			}
+			i++;
+			continue;
+		}
+
+		// read a dotted path, e.g. body.items.0.name
+		size_t end = i;
+		while (end < expr.size() &&
+		       (is_identifier_char(expr[end]) ||
+			(expr[end] == '.' && end + 1 < expr.size() &&
+			 is_identifier_char(expr[end + 1])))) {
+			end++;
+		}
+		const std::string name = expr.substr(i, end - i);
+
+		size_t next = end;
+		while (next < expr.size() && std::isspace((unsigned char)expr[next])) {
+			next++;
+		}
+		const bool is_function = after_pipe || (next < expr.size() && expr[next] == '(');
+		if (is_function) {
+			if (impure_functions.count(name) > 0) {
+				always_render = true;
+			}
+		} else if (file_statements.count(name) > 0) {
+			// included files can change on disk
+			always_render = true;
+		} else if (template_keywords.count(name) == 0) {
+			std::string pointer = "/" + name;
+			std::replace(pointer.begin(), pointer.end(), '.', '/');
+			paths.insert(pointer);
+		}
+		after_pipe = false;
+		i = end;
+	}
+}
+
+} // namespace
+
+void analyze_template_dependencies(const std::string &source,
+				   std::vector<nlohmann::json::json_pointer> &dependencies,
+				   bool &always_render)
+{
+	std::set<std::string> paths;
+	always_render = false;
+
+	size_t pos = 0;
+	while (pos < source.size()) {
+		// find the next expression "{{ }}", statement "{% %}" or line statement "## "
+		const size_t expr_open = source.find("{{", pos);
+		const size_t stmt_open = source.find("{%", pos);
+		size_t line_open = source.find("##", pos);
+		while (line_open != std::string::npos) {
+			// line statements must start a line (after optional whitespace)
+			size_t line_start = source.find_last_of('\n', line_open);
+			line_start = (line_start == std::string::npos) ? 0 : line_start + 1;
+			if (source.find_first_not_of(" \t", line_start) == line_open) {
+				break;
+			}
+			line_open = source.find("##", line_open + 2);
+		}
+
+		const size_t open = std::min({expr_open, stmt_open, line_open});
+		if (open == std::string::npos) {
+			break;
+		}
+		size_t close;
+		size_t close_length = 2;
+		if (open == expr_open) {
+			close = source.find("}}", open + 2);
+		} else if (open == stmt_open) {
+			close = source.find("%}", open + 2);
+		} else {
+			close = source.find('\n', open + 2);
+			close_length = 1;
+		}
+		if (close == std::string::npos) {
+			close = source.size();
+		}
+		analyze_expression(source.substr(open + 2, close - open - 2), paths, always_render);
+		pos = close + close_length;
+	}
+
+	dependencies.clear();
+	for (const auto &path : paths) {
+		dependencies.emplace_back(path);
+	}
+}
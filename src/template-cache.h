@@ -0,0 +1,53 @@
+#ifndef TEMPLATE_CACHE_H
+#define TEMPLATE_CACHE_H
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <inja/inja.hpp>
+
+// A template compiled from its source text. The source is kept so the template is only
+// re-parsed when the text actually changes.
+struct url_source_template {
+	std::string source;
+	inja::Template compiled;
+	bool is_compiled = false;
+	// parse error of the current source, so a broken template isn't re-parsed every tick
+	std::string parse_error;
+	// data paths (as JSON pointers) the template reads, found when it's compiled
+	std::vector<nlohmann::json::json_pointer> dependencies;
+	// the template calls a non-pure function (e.g. strftime) and must render every time
+	bool always_render = false;
+};
+
+// Per-source cache of compiled templates (URL, body and output mappings) along with the inja
+// environment they were parsed with. Callbacks are registered once when the cache is created.
+// Not thread safe - each thread that renders templates should own its cache.
+struct url_source_template_cache {
+	inja::Environment env;
+	url_source_template url;
+	url_source_template body;
+	std::vector<url_source_template> outputs;
+
+	url_source_template_cache();
+};
+
+// (Re)compile a cached template if the source text has changed. Returns false if the
+// template doesn't parse.
+bool compile_cached_template(url_source_template_cache &cache, url_source_template &tmpl,
+			     const std::string &source);
+
+// Render a cached template, (re)compiling it first if the source text has changed.
+// Throws on parse or render errors.
+std::string render_cached_template(url_source_template_cache &cache, url_source_template &tmpl,
+				   const std::string &source, const nlohmann::json &data);
+
+// Scan template source for the variables it references. Paths like "body.items.0" are
+// returned as JSON pointers ("/body/items/0"). Sets always_render if the template calls a
+// function whose result changes without the data changing.
+void analyze_template_dependencies(const std::string &source,
+				   std::vector<nlohmann::json::json_pointer> &dependencies,
+				   bool &always_render);
+
+#endif // TEMPLATE_CACHE_H
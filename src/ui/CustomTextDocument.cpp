@@ -10,31 +10,212 @@
 
 #include <obs.h>
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <vector>
+
+// total size of the cached images
+const qint64 image_cache_budget_bytes = 64 * 1024 * 1024;
+// cached images are fetched again after this long
+const uint64_t image_cache_ttl_ns = 5ull * 60 * 1000000000;
+// images are downscaled to at most this size (or the document width) before caching
+const int image_max_dimension = 4096;
+// time to wait for prefetched images before laying out without them
+const long image_prefetch_timeout_ms = 5000;
+// most images fetched at once by a prefetch, the others wait for one of these
+const size_t image_prefetch_max_parallel = 4;
+
+// the widest an image is shown (and cached) in a document of this width
+int image_max_width(qreal text_width)
+{
+	return text_width > 0 ? std::min((int)text_width, image_max_dimension) : image_max_dimension;
+}
+
+QString image_cache_key(const QUrl &url, int max_width)
+{
+	return QString::number(max_width) + " " + url.toString();
+}
+
+// Decode image bytes and downscale to the size it will be shown at
+QImage decode_image(const std::vector<uint8_t> &image_bytes, int max_width)
+{
+	// Create a QByteArray from the std::vector<uint8_t>
+	QByteArray imageData(reinterpret_cast<const char *>(image_bytes.data()),
+			     image_bytes.size());
+	QBuffer buffer(&imageData);
+	buffer.open(QIODevice::ReadOnly);
+	QImageReader reader(&buffer);
+	reader.setDecideFormatFromContent(true);
+	QImage image = reader.read();
+	if (!image.isNull() && (image.width() > max_width || image.height() > image_max_dimension)) {
+		image = image.scaled(max_width, image_max_dimension, Qt::KeepAspectRatio,
+				     Qt::SmoothTransformation);
+	}
+	return image;
+}
+
+bool is_http_url(const QUrl &url)
+{
+	return url.scheme() == "http" || url.scheme() == "https";
+}
+
+bool ImageCache::get(const QString &key, QImage &image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(key);
+	if (it == entries.end()) {
+		counters.misses++;
+		return false;
+	}
+	if (get_time_ns() >= it->expires_ns) {
+		// stale - fetch it again
+		counters.expirations++;
+		counters.misses++;
+		remove(it);
+		return false;
+	}
+	counters.hits++;
+	lru.splice(lru.begin(), lru, it->lru_position);
+	image = it->image;
+	return true;
+}
+
+bool ImageCache::contains(const QString &key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(key);
+	return it != entries.end() && get_time_ns() < it->expires_ns;
+}
+
+void ImageCache::insert(const QString &key, const QImage &image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto existing = entries.find(key);
+	if (existing != entries.end()) {
+		remove(existing);
+	}
+	const qint64 bytes = image.sizeInBytes();
+	if (bytes > image_cache_budget_bytes) {
+		return;
+	}
+	while (counters.bytes + bytes > image_cache_budget_bytes && !lru.empty()) {
+		counters.evictions++;
+		remove(entries.find(lru.back()));
+	}
+	lru.push_front(key);
+	entries.insert(key, {image, bytes, get_time_ns() + image_cache_ttl_ns, lru.begin()});
+	counters.bytes += bytes;
+	counters.count = (int)entries.size();
+}
+
+ImageCache::Stats ImageCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+void ImageCache::remove(QHash<QString, Entry>::iterator it)
+{
+	counters.bytes -= it->bytes;
+	lru.erase(it->lru_position);
+	entries.erase(it);
+	counters.count = (int)entries.size();
+}
+
 // Initialize the static member
-QHash<QUrl, QImage> CustomTextDocument::imageCache;
+ImageCache CustomTextDocument::imageCache;
 
 CustomTextDocument::CustomTextDocument(QObject *parent) : QTextDocument(parent) {}
 
+ImageCache::Stats CustomTextDocument::imageCacheStats()
+{
+	return imageCache.stats();
+}
+
+void CustomTextDocument::prefetchImages(const QString &html, qreal width)
+{
+	static const QRegularExpression img_src(
+		R"(<img\b[^>]*?\bsrc\s*=\s*(?:"([^"]*)"|'([^']*)'))",
+		QRegularExpression::CaseInsensitiveOption);
+
+	const int max_width = image_max_width(width);
+	// cache key and url of the images to fetch
+	std::vector<std::pair<QString, std::string>> missing;
+	QRegularExpressionMatchIterator matches = img_src.globalMatch(html);
+	while (matches.hasNext()) {
+		const QRegularExpressionMatch match = matches.next();
+		QString src = match.captured(1).isNull() ? match.captured(2) : match.captured(1);
+		src.replace("&amp;", "&");
+		const QUrl url(src);
+		if (!is_http_url(url)) {
+			continue;
+		}
+		const QString key = image_cache_key(url, max_width);
+		bool listed = false;
+		for (const auto &image : missing) {
+			listed = listed || image.first == key;
+		}
+		if (!listed && !imageCache.contains(key)) {
+			missing.emplace_back(key, url.toString().toStdString());
+		}
+	}
+
+	// fetch and decode them on a few threads, each takes the next image until all are done.
+	// The timeout bounds the whole wait, images not fetched by then are left out
+	const uint64_t deadline_ns = get_time_ns() + (uint64_t)image_prefetch_timeout_ms * 1000000;
+	std::atomic<size_t> next_image{0};
+	auto fetch_images = [&missing, &next_image, deadline_ns, max_width]() {
+		for (size_t i = next_image++; i < missing.size(); i = next_image++) {
+			const uint64_t now_ns = get_time_ns();
+			if (now_ns >= deadline_ns) {
+				return;
+			}
+			const auto &image = missing[i];
+			std::string mime_type;
+			const std::vector<uint8_t> image_bytes = fetch_image(
+				image.second, mime_type,
+				std::max(1L, (long)((deadline_ns - now_ns) / 1000000)));
+			const QImage decoded = decode_image(image_bytes, max_width);
+			if (decoded.isNull()) {
+				obs_log(LOG_WARNING, "Unable to load image from: %s",
+					image.second.c_str());
+				continue;
+			}
+			imageCache.insert(image.first, decoded);
+		}
+	};
+	std::vector<std::future<void>> fetches;
+	const size_t thread_count = std::min(missing.size(), image_prefetch_max_parallel);
+	for (size_t i = 0; i < thread_count; i++) {
+		fetches.push_back(std::async(std::launch::async, fetch_images));
+	}
+	for (auto &fetch : fetches) {
+		fetch.wait();
+	}
+}
+
 QVariant CustomTextDocument::loadResource(int type, const QUrl &name)
 {
 	if (type == QTextDocument::ImageResource) {
-		if (imageCache.contains(name)) {
-			return QVariant(imageCache.value(name));
+		// the image is shown at most as wide as the document, cache it at that size
+		const int max_width = image_max_width(textWidth());
+		const QString key = image_cache_key(name, max_width);
+		QImage image;
+		if (imageCache.get(key, image)) {
+			return QVariant(image);
+		}
+		if (imagesPrefetched && is_http_url(name)) {
+			// the prefetch failed or timed out, don't block the layout on it
+			return QVariant();
 		}
 		obs_log(LOG_INFO, "fetch %s", name.toString().toStdString().c_str());
 		std::string mime_type;
 		std::vector<uint8_t> image_bytes =
 			fetch_image(name.toString().toStdString(), mime_type);
-		// Create a QByteArray from the std::vector<uint8_t>
-		QByteArray imageData(reinterpret_cast<const char *>(image_bytes.data()),
-				     image_bytes.size());
-		QBuffer buffer(&imageData);
-		buffer.open(QIODevice::ReadOnly);
-		QImageReader reader(&buffer);
-		reader.setDecideFormatFromContent(true);
-		QImage image = reader.read();
+		image = decode_image(image_bytes, max_width);
 		if (!image.isNull()) {
-			imageCache[name] = image;
+			imageCache.insert(key, image);
 			return image;
 		}
 		obs_log(LOG_ERROR, "Unable to load image from: %s",
@@ -43,3 +224,13 @@ QVariant CustomTextDocument::loadResource(int type, const QUrl &name)
 	}
 	return QTextDocument::loadResource(type, name);
 }
+
+std::string format_image_cache_stats()
+{
+	const ImageCache::Stats stats = CustomTextDocument::imageCacheStats();
+	return "Image cache: " + std::to_string(stats.count) + " images, " +
+	       std::to_string(stats.bytes / 1024) + " KiB, hits: " + std::to_string(stats.hits) +
+	       ", misses: " + std::to_string(stats.misses) +
+	       ", evictions: " + std::to_string(stats.evictions) +
+	       ", expired: " + std::to_string(stats.expirations);
+}
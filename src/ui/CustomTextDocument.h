@@ -6,17 +6,73 @@
 #include <QUrl>
 #include <QHash>
 
+#include <list>
+#include <mutex>
+#include <string>
+
+// Images loaded by the text documents, shared by all of them. Bounded by a byte budget (least
+// recently used images are evicted first) and images expire so changed images are fetched again.
+class ImageCache {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t expirations = 0;
+		qint64 bytes = 0;
+		int count = 0;
+	};
+
+	// Get a cached image that hasn't expired. Counts a hit or a miss.
+	bool get(const QString &key, QImage &image);
+	// Check for an image that hasn't expired, without counting it
+	bool contains(const QString &key);
+	void insert(const QString &key, const QImage &image);
+	Stats stats() const;
+
+private:
+	struct Entry {
+		QImage image;
+		qint64 bytes;
+		uint64_t expires_ns;
+		std::list<QString>::iterator lru_position;
+	};
+
+	void remove(QHash<QString, Entry>::iterator it);
+
+	mutable std::mutex mutex;
+	QHash<QString, Entry> entries;
+	// most recently used first
+	std::list<QString> lru;
+	Stats counters;
+};
+
 class CustomTextDocument : public QTextDocument {
 	Q_OBJECT
 
 public:
 	CustomTextDocument(QObject *parent = nullptr);
 
+	static ImageCache::Stats imageCacheStats();
+
+	// Fetch the http(s) images the HTML shows in a document of this width that aren't cached
+	// yet, a few in parallel and with a timeout, into the shared image cache. Thread-safe, it's
+	// called before the render is handed to the render thread so it doesn't wait on them.
+	static void prefetchImages(const QString &html, qreal width);
+
+	// The images were prefetched: don't fetch images during layout, images that failed to
+	// load are left out
+	void setImagesPrefetched(bool prefetched) { imagesPrefetched = prefetched; }
+
 protected:
 	QVariant loadResource(int type, const QUrl &name) override;
 
 private:
-	static QHash<QUrl, QImage> imageCache; // Static member for the cache
+	static ImageCache imageCache; // Static member for the cache
+	bool imagesPrefetched = false;
 };
 
+// Image cache statistics for display
+std::string format_image_cache_stats();
+
 #endif // CUSTOMTEXTDOCUMENT_H
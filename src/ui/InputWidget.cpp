@@ -38,9 +38,21 @@ InputWidget::InputWidget(QWidget *parent) : QWidget(parent), ui(new Ui::InputWid
 		}
 		ui->comboBox_resizeInput->setVisible(!hide_resize_option);
 		ui->label_resizeInput->setVisible(!hide_resize_option);
+		ui->comboBox_imageFormat->setVisible(!hide_resize_option);
+		ui->spinBox_imageQuality->setVisible(!hide_resize_option);
+		ui->spinBox_changeThreshold->setVisible(!hide_resize_option);
 	};
 	connect(ui->obsTextSourceComboBox, &QComboBox::currentTextChanged, this,
 		inputSourceSelected);
+
+	// PNG is lossless, the quality only applies to JPEG and WebP
+	auto setImageQualityEnabled = [=]() {
+		ui->spinBox_imageQuality->setEnabled(
+			ui->comboBox_imageFormat->currentIndex() != 0);
+	};
+	connect(ui->comboBox_imageFormat, &QComboBox::currentTextChanged, this,
+		setImageQualityEnabled);
+	setImageQualityEnabled();
 }
 
 InputWidget::~InputWidget()
@@ -58,6 +70,9 @@ void InputWidget::setInputData(const input_data &input)
 	}
 	ui->aggToTarget->setChecked(input.aggregate);
 	ui->comboBox_resizeInput->setCurrentText(input.resize_method.c_str());
+	ui->comboBox_imageFormat->setCurrentText(input.image_format.c_str());
+	ui->spinBox_imageQuality->setValue(input.image_quality);
+	ui->spinBox_changeThreshold->setValue(input.image_change_threshold);
 	ui->obsTextSourceEnabledCheckBox->setChecked(input.no_empty);
 	ui->obsTextSourceSkipSameCheckBox->setChecked(input.no_same);
 }
@@ -74,6 +89,9 @@ input_data InputWidget::getInputDataFromUI()
 	}
 	input.aggregate = ui->aggToTarget->isChecked();
 	input.resize_method = ui->comboBox_resizeInput->currentText().toUtf8().constData();
+	input.image_format = ui->comboBox_imageFormat->currentText().toUtf8().constData();
+	input.image_quality = ui->spinBox_imageQuality->value();
+	input.image_change_threshold = (float)ui->spinBox_changeThreshold->value();
 	input.no_empty = ui->obsTextSourceEnabledCheckBox->isChecked();
 	input.no_same = ui->obsTextSourceSkipSameCheckBox->isChecked();
 
@@ -9,6 +9,7 @@
 #include <obs-module.h>
 
 #include "obs-source-util.h"
+#include "template-cache.h"
 
 void set_form_row_visibility(QFormLayout *layout, QWidget *widget, bool visible)
 {
@@ -205,7 +206,7 @@ RequestBuilder::RequestBuilder(url_source_request_data *request_data,
         {
           "type": "image_url",
           "image_url": {
-            "url": "data:image/png;base64,{{imageb64}}"
+            "url": "data:{{imagemime}};base64,{{imageb64}}"
           }
         }
       ]
@@ -549,8 +550,9 @@ RequestBuilder::RequestBuilder(url_source_request_data *request_data,
 
 			obs_log(LOG_INFO, "Sending request to %s", request_data_test.url.c_str());
 
+			url_source_template_cache templates_test;
 			request_data_handler_response response =
-				request_data_handler(&request_data_test);
+				request_data_handler(&request_data_test, &templates_test);
 
 			if (response.status_code != URL_SOURCE_REQUEST_SUCCESS) {
 				emit show_error_message_signal(response.error_message);
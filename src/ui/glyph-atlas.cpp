@@ -0,0 +1,332 @@
+#include "glyph-atlas.h"
+#include "render-worker.h"
+
+#include <QColor>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QImage>
+#include <QPainter>
+#include <QString>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// QTextDocument's default document margin, so the fast path lines up with regular renders
+const int document_margin = 4;
+const int max_fast_text_length = 64;
+const int atlas_width = 1024;
+// room around each glyph for anti-aliasing
+const int glyph_padding = 2;
+// how far the advance of the whole text may be off the sum of the glyph advances
+const qreal max_advance_difference = 0.01;
+const size_t max_cached_styles = 64;
+const size_t max_atlases = 32;
+
+struct fast_text_style {
+	bool supported = false;
+	QFont font;
+	QColor color;
+};
+
+struct atlas_glyph {
+	// the glyph's pixels in the atlas image
+	QRect cell;
+	// top left of the cell relative to the pen position on the baseline
+	QPointF offset;
+	qreal advance;
+};
+
+// Glyphs of one font and color, rasterized once into cells of a shared image. Each cell is
+// sized to its glyph's bounding rect, cells are packed left to right on shelves.
+struct glyph_atlas {
+	QFont font;
+	QColor color;
+	QFontMetricsF metrics;
+	QImage image;
+	// the shelf new glyphs go on: its top, its height so far and the x of the next cell
+	int shelf_y = 0;
+	int shelf_height = 0;
+	int shelf_x = 0;
+	std::unordered_map<char32_t, atlas_glyph> glyphs;
+
+	glyph_atlas(const QFont &font_, const QColor &color_)
+		: font(font_),
+		  color(color_),
+		  metrics(font_)
+	{
+	}
+};
+
+// Only accessed from the render thread
+std::map<std::string, fast_text_style> styles;
+std::map<std::string, std::unique_ptr<glyph_atlas>> atlases;
+
+fast_text_style parse_fast_text_style(const std::string &css_props)
+{
+	fast_text_style style;
+	bool has_color = false;
+	const QStringList declarations = QString::fromStdString(css_props).split(';');
+	for (const QString &declaration : declarations) {
+		if (declaration.trimmed().isEmpty()) {
+			continue;
+		}
+		const int colon = declaration.indexOf(':');
+		if (colon < 0) {
+			return style;
+		}
+		const QString property = declaration.left(colon).trimmed().toLower();
+		const QString value = declaration.mid(colon + 1).trimmed();
+		bool ok = true;
+		if (property == "color") {
+			style.color = QColor(value);
+			if (!style.color.isValid()) {
+				return style;
+			}
+			has_color = true;
+		} else if (property == "font-size") {
+			if (value.size() < 3) {
+				return style;
+			}
+			const QString unit = value.right(2).toLower();
+			const double size = value.chopped(2).trimmed().toDouble(&ok);
+			if (!ok || size <= 0) {
+				return style;
+			}
+			if (unit == "px") {
+				style.font.setPixelSize((int)std::lround(size));
+			} else if (unit == "pt") {
+				style.font.setPointSizeF(size);
+			} else {
+				return style;
+			}
+		} else if (property == "font-family") {
+			QString family = value.split(',').first().trimmed();
+			family.remove('"');
+			family.remove('\'');
+			style.font.setFamily(family);
+		} else if (property == "font-weight") {
+			if (value == "bold") {
+				style.font.setWeight(QFont::Bold);
+			} else if (value == "normal") {
+				style.font.setWeight(QFont::Normal);
+			} else {
+				const int weight = value.toInt(&ok);
+				if (!ok || weight < 1 || weight > 1000) {
+					return style;
+				}
+				style.font.setWeight((QFont::Weight)weight);
+			}
+		} else if (property == "font-style") {
+			if (value != "italic" && value != "normal") {
+				return style;
+			}
+			style.font.setItalic(value == "italic");
+		} else if (property == "background-color" || property == "background") {
+			if (value.toLower() != "transparent") {
+				return style;
+			}
+		} else {
+			// anything else needs the full document layout
+			return style;
+		}
+	}
+	style.supported = has_color;
+	return style;
+}
+
+const fast_text_style &get_style(const std::string &css_props)
+{
+	auto it = styles.find(css_props);
+	if (it != styles.end()) {
+		return it->second;
+	}
+	if (styles.size() >= max_cached_styles) {
+		styles.clear();
+	}
+	return styles.emplace(css_props, parse_fast_text_style(css_props)).first->second;
+}
+
+glyph_atlas &get_atlas(const fast_text_style &style)
+{
+	const std::string key = style.font.key().toStdString() + "|" +
+				style.color.name(QColor::HexArgb).toStdString();
+	auto it = atlases.find(key);
+	if (it != atlases.end()) {
+		return *it->second;
+	}
+	if (atlases.size() >= max_atlases) {
+		atlases.clear();
+	}
+	auto inserted =
+		atlases.emplace(key, std::make_unique<glyph_atlas>(style.font, style.color));
+	return *inserted.first->second;
+}
+
+const atlas_glyph &get_glyph(glyph_atlas &atlas, char32_t c)
+{
+	auto it = atlas.glyphs.find(c);
+	if (it != atlas.glyphs.end()) {
+		return it->second;
+	}
+
+	// the cell fits the glyph's pixels, which can reach past its advance, the ascent or the
+	// descent (e.g. italics and accents)
+	const QString character = QString::fromUcs4(&c, 1);
+	const QRectF bounds = atlas.metrics.boundingRect(character);
+	const int cell_width =
+		std::min((int)std::ceil(bounds.width()) + 2 * glyph_padding, atlas_width);
+	const int cell_height = (int)std::ceil(bounds.height()) + 2 * glyph_padding;
+	if (atlas.shelf_x + cell_width > atlas_width) {
+		// start a new shelf below the current one
+		atlas.shelf_y += atlas.shelf_height;
+		atlas.shelf_height = 0;
+		atlas.shelf_x = 0;
+	}
+	atlas.shelf_height = std::max(atlas.shelf_height, cell_height);
+	if (atlas.shelf_y + atlas.shelf_height > atlas.image.height()) {
+		// grow the atlas, at least doubling it
+		QImage grown(atlas_width,
+			     std::max(atlas.shelf_y + atlas.shelf_height, 2 * atlas.image.height()),
+			     QImage::Format_ARGB32_Premultiplied);
+		grown.fill(Qt::transparent);
+		if (!atlas.image.isNull()) {
+			QPainter painter(&grown);
+			painter.setCompositionMode(QPainter::CompositionMode_Source);
+			painter.drawImage(0, 0, atlas.image);
+		}
+		atlas.image = grown;
+	}
+
+	const QRect cell(atlas.shelf_x, atlas.shelf_y, cell_width, cell_height);
+	atlas.shelf_x += cell_width;
+	const QPointF offset(bounds.left() - glyph_padding, bounds.top() - glyph_padding);
+	QPainter painter(&atlas.image);
+	painter.setFont(atlas.font);
+	painter.setPen(atlas.color);
+	painter.setClipRect(cell);
+	painter.drawText(QPointF(cell.x() - offset.x(), cell.y() - offset.y()), character);
+	painter.end();
+
+	const atlas_glyph glyph = {cell, offset, atlas.metrics.horizontalAdvance(character)};
+	return atlas.glyphs.emplace(c, glyph).first->second;
+}
+
+// Scripts drawn one character at a time the way a text layout draws them, without contextual
+// forms or reordering
+bool is_unshaped_script(QChar::Script script)
+{
+	switch (script) {
+	case QChar::Script_Common:
+	case QChar::Script_Latin:
+	case QChar::Script_Greek:
+	case QChar::Script_Cyrillic:
+	case QChar::Script_Han:
+	case QChar::Script_Hiragana:
+	case QChar::Script_Katakana:
+	case QChar::Script_Hangul:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Check the characters can be drawn from the atlas font's own glyphs, one by one. Text that
+// needs a fallback font or shaping is laid out by QTextDocument.
+bool is_atlas_text(const glyph_atlas &atlas, const QList<uint> &characters)
+{
+	for (const uint c : characters) {
+		if (!atlas.metrics.inFontUcs4(c) || QChar::isMark(c) ||
+		    !is_unshaped_script(QChar::script(c))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool is_fast_text(const QString &text)
+{
+	if (text.isEmpty() || text.size() > max_fast_text_length) {
+		return false;
+	}
+	// leading, trailing or repeated spaces collapse in HTML
+	if (text.startsWith(' ') || text.endsWith(' ') || text.contains("  ")) {
+		return false;
+	}
+	for (const QChar c : text) {
+		if (c == '<' || c == '>' || c == '&' || (c.isSpace() && c != ' ')) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+bool render_text_with_glyph_atlas(const std::string &text, uint32_t &width, uint32_t &height,
+				  frame_buffer &buffer, frame_buffer_pool &pool,
+				  const std::string &css_props)
+{
+	const QString qtext = QString::fromStdString(text);
+	if (!is_fast_text(qtext)) {
+		return false;
+	}
+	const fast_text_style &style = get_style(css_props);
+	if (!style.supported) {
+		return false;
+	}
+	glyph_atlas &atlas = get_atlas(style);
+	const QList<uint> characters = qtext.toUcs4();
+	if (!is_atlas_text(atlas, characters)) {
+		return false;
+	}
+
+	// lay the glyphs out on one line
+	std::vector<std::pair<const atlas_glyph *, qreal>> placed;
+	qreal x = document_margin;
+	for (const uint c : characters) {
+		const atlas_glyph &glyph = get_glyph(atlas, c);
+		placed.emplace_back(&glyph, x);
+		x += glyph.advance;
+	}
+	if (std::abs(x - document_margin - atlas.metrics.horizontalAdvance(qtext)) >
+	    max_advance_difference) {
+		// the text is kerned (or otherwise shaped), the glyphs don't line up on their own
+		return false;
+	}
+	if (x + document_margin > width) {
+		// it would wrap
+		return false;
+	}
+
+	height = (uint32_t)std::ceil(atlas.metrics.ascent() + atlas.metrics.descent()) +
+		 2 * document_margin;
+	buffer = frame_buffer_pool_acquire(pool, (size_t)width * height * 4);
+	QImage image(buffer.data, (int)width, (int)height, (qsizetype)width * 4,
+		     QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+	QPainter painter(&image);
+	const qreal baseline = document_margin + atlas.metrics.ascent();
+	for (const auto &glyph : placed) {
+		painter.drawImage(QPointF(glyph.second + glyph.first->offset.x(),
+					  baseline + glyph.first->offset.y()),
+				  atlas.image, glyph.first->cell);
+	}
+	painter.end();
+	return true;
+}
+
+void glyph_atlas_free(void)
+{
+	// the fonts and images belong to the render thread
+	render_worker_submit(RENDER_PRIORITY_HIDDEN, []() {
+		atlases.clear();
+		styles.clear();
+	}).get();
+}
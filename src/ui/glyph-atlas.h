@@ -0,0 +1,36 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Release the cached glyphs (on the render thread). Called on module unload.
+void glyph_atlas_free(void);
+
+#ifdef __cplusplus
+}
+
+#include "frame-buffer-pool.h"
+
+#include <string>
+
+/**
+  * Fast path for short, plain text (clocks, scores, counters): compose the text from glyphs
+  * cached in an atlas per font and color instead of a full QTextDocument layout.
+  * Only handles single-line text without markup, styled with color, font-size, font-family,
+  * font-weight, font-style and a transparent background, drawn from the font's own glyphs:
+  * text that needs a fallback font, kerning or shaping is left to QTextDocument so both paths
+  * render it the same. Must run on the render thread.
+  * @param width In: the render width, out: the frame width
+  * @param height Out: the frame height
+  * @param buffer Output buffer (BGRA, premultiplied alpha), taken from the pool
+  * @return false if the text or CSS isn't supported - nothing is rendered then
+  */
+bool render_text_with_glyph_atlas(const std::string &text, uint32_t &width, uint32_t &height,
+				  frame_buffer &buffer, frame_buffer_pool &pool,
+				  const std::string &css_props);
+
+#endif
+
+#endif // GLYPH_ATLAS_H
@@ -2,6 +2,7 @@
 #include "outputmapping.h"
 #include "ui_outputmapping.h"
 #include "obs-ui-utils.h"
+#include "shm-output.h"
 
 #include <QComboBox>
 #include <QHeaderView>
@@ -22,13 +23,16 @@ const std::string default_template_string = R"({{output}})";
 } // namespace
 
 OutputMapping::OutputMapping(const output_mapping_data &mapping_data_in,
-			     update_handler_t update_handler_in, QWidget *parent)
+			     const std::string &source_name_in, update_handler_t update_handler_in,
+			     QWidget *parent)
 	: QDialog(parent),
 	  ui(new Ui::OutputMapping),
 	  mapping_data(mapping_data_in),
+	  source_name(source_name_in),
 	  update_handler(update_handler_in)
 {
 	ui->setupUi(this);
+	ui->label_shm_output->setVisible(false);
 
 	model.setHorizontalHeaderLabels(QStringList() << "Mapping Name"
 						      << "Output");
@@ -69,6 +73,7 @@ OutputMapping::OutputMapping(const output_mapping_data &mapping_data_in,
 				ui->checkBox_unhide_Source->blockSignals(false);
 				ui->lineEdit_file_output->blockSignals(false);
 			}
+			updateSharedMemoryName(enable ? selected.indexes().first().row() : -1);
 		});
 
 	// connect toolButton_addMapping to addMapping
@@ -151,6 +156,7 @@ OutputMapping::OutputMapping(const output_mapping_data &mapping_data_in,
 		// update mapping name
 		if (item->column() == 0) {
 			this->mapping_data.mappings[item->row()].name = item->text().toStdString();
+			updateSharedMemoryName(item->row());
 		}
 	});
 }
@@ -170,8 +176,10 @@ QComboBox *OutputMapping::createSourcesComboBox()
 	comboBox->addItem(QString::fromStdString(none_internal_rendering));
 	// add "File output" to the comboBox
 	comboBox->addItem(QString::fromStdString(file_output_rendering));
-	// add "Save to source settings" to the comboBox
-	comboBox->addItem(QString::fromStdString(save_to_setting));
+	// add "Publish to output channel" to the comboBox
+	comboBox->addItem(QString::fromStdString(publish_to_output_channel));
+	// add "Shared memory output" to the comboBox
+	comboBox->addItem(QString::fromStdString(shared_memory_output));
 	// add all text and media sources to the comboBox
 	obs_enum_sources(add_sources_to_combobox, comboBox);
 	// connect comboBox to update_handler
@@ -197,6 +205,7 @@ QComboBox *OutputMapping::createSourcesComboBox()
 		}
 		// set the css_props of the selected row to the plainTextEdit_cssProps text
 		this->mapping_data.mappings[row].output_source = output_name_without_prefix;
+		updateSharedMemoryName(row);
 		// call update_handler
 		this->update_handler(this->mapping_data);
 	});
@@ -204,6 +213,21 @@ QComboBox *OutputMapping::createSourcesComboBox()
 	return comboBox;
 }
 
+/// @brief show the shared memory name a mapping publishes to, if it's a shared memory output
+/// @param row the mapping's row, -1 if none is selected
+void OutputMapping::updateSharedMemoryName(int row)
+{
+	if (row < 0 || row >= (int)mapping_data.mappings.size() ||
+	    mapping_data.mappings[row].output_source != shared_memory_output) {
+		ui->label_shm_output->setVisible(false);
+		return;
+	}
+	const std::string name =
+		shm_output_name_for_mapping(source_name, mapping_data.mappings[row].name);
+	ui->label_shm_output->setText(QString("Shared memory name: %1").arg(name.c_str()));
+	ui->label_shm_output->setVisible(true);
+}
+
 void OutputMapping::addMapping()
 {
 	// add row to model
@@ -18,7 +18,8 @@ class OutputMapping : public QDialog {
 
 public:
 	explicit OutputMapping(const output_mapping_data &mapping_data_in,
-			       update_handler_t update_handler, QWidget *parent = nullptr);
+			       const std::string &source_name_in, update_handler_t update_handler,
+			       QWidget *parent = nullptr);
 	~OutputMapping();
 
 	OutputMapping(const OutputMapping &) = delete;
@@ -28,7 +29,10 @@ private:
 	Ui::OutputMapping *ui;
 	QStandardItemModel model;
 	output_mapping_data mapping_data;
+	// name of the URL source, shared memory output names include it
+	std::string source_name;
 	QComboBox *createSourcesComboBox();
+	void updateSharedMemoryName(int row);
 	update_handler_t update_handler;
 
 private slots:
@@ -1,121 +1,159 @@
 #include "CustomTextDocument.h"
-#include <util/bmem.h>
+#include "text-render-helper.h"
+#include "render-worker.h"
 
-const QString template_text = R"(
-<html>
+#include <algorithm>
 
-<head>
-	<style>
-		html,
-		body,
-		body div,
-		span,
-		object,
-		iframe,
-		h1,
-		h2,
-		h3,
-		h4,
-		h5,
-		h6,
-		p,
-		blockquote,
-		pre,
-		abbr,
-		address,
-		cite,
-		code,
-		del,
-		dfn,
-		em,
-		img,
-		ins,
-		kbd,
-		q,
-		samp,
-		small,
-		strong,
-		sub,
-		sup,
-		var,
-		b,
-		i,
-		dl,
-		dt,
-		dd,
-		ol,
-		ul,
-		li,
-		fieldset,
-		form,
-		label,
-		legend,
-		table,
-		caption,
-		tbody,
-		tfoot,
-		thead,
-		tr,
-		th,
-		td,
-		article,
-		aside,
-		figure,
-		footer,
-		header,
-		hgroup,
-		menu,
-		nav,
-		section,
-		time,
-		mark,
-		audio,
-		video {
-			margin: 0;
-			padding: 0;
-			border: 0;
-			outline: 0;
-			font-size: 100%;
-			vertical-align: baseline;
-			background: transparent;
-		}
+// Reset stylesheet of the rendered text, the mapping's CSS is applied to #text after it
+const QString reset_stylesheet = R"(
+html,
+body,
+body div,
+span,
+object,
+iframe,
+h1,
+h2,
+h3,
+h4,
+h5,
+h6,
+p,
+blockquote,
+pre,
+abbr,
+address,
+cite,
+code,
+del,
+dfn,
+em,
+img,
+ins,
+kbd,
+q,
+samp,
+small,
+strong,
+sub,
+sup,
+var,
+b,
+i,
+dl,
+dt,
+dd,
+ol,
+ul,
+li,
+fieldset,
+form,
+label,
+legend,
+table,
+caption,
+tbody,
+tfoot,
+thead,
+tr,
+th,
+td,
+article,
+aside,
+figure,
+footer,
+header,
+hgroup,
+menu,
+nav,
+section,
+time,
+mark,
+audio,
+video {
+	margin: 0;
+	padding: 0;
+	border: 0;
+	outline: 0;
+	font-size: 100%;
+	vertical-align: baseline;
+	background: transparent;
+}
+)";
 
-		#text {
-			{{css_props}}
-		}
-	</style>
-</head>
+// widest frame rendered, which is also a safe texture size on all graphics backends
+const int max_render_width = 16384;
 
-<body>
-	<div id="text">{{text}}</div>
-</body>
+void text_document_deleter::operator()(CustomTextDocument *document) const
+{
+	// the document lives on the render thread, delete it there
+	render_worker_submit(RENDER_PRIORITY_HIDDEN, [document]() { delete document; });
+}
 
-</html>
-)";
+// a width of 0 lays the text out on a single line (for the marquee)
+static qreal document_text_width(uint32_t width)
+{
+	return width > 0 ? (qreal)width : -1;
+}
+
+void prefetch_text_images(const std::string &text, uint32_t width)
+{
+	CustomTextDocument::prefetchImages(QString::fromStdString(text),
+					   document_text_width(width));
+}
 
 /**
   * Render text to a buffer using QTextDocument
   * @param text Text to render
-  * @param width Output width
+  * @param width Output width, 0 to render the text on one line without wrapping
   * @param height Output height
-  * @param data Output buffer, user must free
+  * @param buffer Output buffer (BGRA, premultiplied alpha), taken from the pool
+  * @param pool Pool of reusable buffers
 	* @param css_props CSS properties to apply to the text
+  * @param document Document of the mapping, created on the first render and kept after
   */
 void render_text_with_qtextdocument(const std::string &text, uint32_t &width, uint32_t &height,
-				    uint8_t **data, const std::string &css_props)
+				    frame_buffer &buffer, frame_buffer_pool &pool,
+				    const std::string &css_props, text_render_document &document)
 {
-	// apply response in template
-	QString html = QString(template_text)
-			       .replace("{{text}}", QString::fromStdString(text))
-			       .replace("{{css_props}}", QString::fromStdString(css_props));
-	CustomTextDocument textDocument;
+	if (!document.document) {
+		document.document.reset(new CustomTextDocument());
+		document.document->setUndoRedoEnabled(false);
+		document.has_stylesheet = false;
+	}
+	CustomTextDocument &textDocument = *document.document;
+	if (!document.has_stylesheet || document.css_props != css_props) {
+		// the stylesheet is parsed here, once, and not on every render
+		textDocument.setDefaultStyleSheet(reset_stylesheet + "#text {" +
+						  QString::fromStdString(css_props) + "}");
+		document.css_props = css_props;
+		document.has_stylesheet = true;
+	}
+	// only the content changes between renders. Clearing drops the images the document
+	// loaded before, so they come from the shared image cache (and expire with it)
+	const QString html = "<div id=\"text\">" + QString::fromStdString(text) + "</div>";
+	textDocument.clear();
+	// the width is set first: images load during setHtml and are cached by the width they're
+	// shown at, the same key prefetch_text_images filled
+	textDocument.setTextWidth(document_text_width(width));
+	textDocument.setImagesPrefetched(true);
 	textDocument.setHtml(html);
-	textDocument.setTextWidth(width);
 
-	QPixmap pixmap(textDocument.size().toSize());
-	pixmap.fill(Qt::transparent);
+	// get width and height
+	const QSize size = textDocument.size().toSize();
+	width = (uint32_t)std::clamp(size.width(), 0, max_render_width);
+	height = (uint32_t)std::max(size.height(), 0);
+	if (width == 0 || height == 0) {
+		return;
+	}
+
+	// paint straight into a pooled buffer, QImage only wraps the memory
+	buffer = frame_buffer_pool_acquire(pool, (size_t)width * height * 4);
+	QImage image(buffer.data, (int)width, (int)height, (qsizetype)width * 4,
+		     QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
 	QPainter painter;
-	painter.begin(&pixmap);
+	painter.begin(&image);
 	painter.setCompositionMode(QPainter::CompositionMode_Source);
 
 	// render text
@@ -123,14 +161,44 @@ void render_text_with_qtextdocument(const std::string &text, uint32_t &width, ui
 
 	painter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
 	painter.end();
+}
 
-	// save pixmap to buffer
-	QImage image = pixmap.toImage();
-	// get width and height
-	width = image.width();
-	height = image.height();
-	// allocate output buffer (RGBA), user must free
-	*data = (uint8_t *)bzalloc(width * height * 4);
-	// copy image data to output buffer
-	memcpy(*data, image.bits(), width * height * 4);
+void render_image_to_buffer(const std::vector<uint8_t> &image_bytes, uint32_t &width,
+			    uint32_t &height, frame_buffer &buffer, frame_buffer_pool &pool)
+{
+	const uint32_t max_width = width;
+	width = 0;
+	height = 0;
+
+	QByteArray imageData = QByteArray::fromRawData(
+		reinterpret_cast<const char *>(image_bytes.data()), (qsizetype)image_bytes.size());
+	QBuffer imageBuffer(&imageData);
+	imageBuffer.open(QIODevice::ReadOnly);
+	QImageReader reader(&imageBuffer);
+	reader.setDecideFormatFromContent(true);
+	QSize size = reader.size();
+	if (max_width > 0 && size.isValid() && (uint32_t)size.width() > max_width) {
+		// let the decoder scale (e.g. JPEG can decode at a lower resolution)
+		size = size.scaled((int)max_width, size.height(), Qt::KeepAspectRatio);
+		reader.setScaledSize(size);
+	}
+	QImage image = reader.read();
+	if (image.isNull()) {
+		return;
+	}
+	if (max_width > 0 && (uint32_t)image.width() > max_width) {
+		// the size wasn't known before decoding
+		image = image.scaledToWidth((int)max_width, Qt::SmoothTransformation);
+	}
+	width = (uint32_t)std::min(image.width(), max_render_width);
+	height = (uint32_t)image.height();
+
+	// convert into a pooled buffer (BGRA, premultiplied alpha)
+	buffer = frame_buffer_pool_acquire(pool, (size_t)width * height * 4);
+	QImage frame(buffer.data, (int)width, (int)height, (qsizetype)width * 4,
+		     QImage::Format_ARGB32_Premultiplied);
+	QPainter painter(&frame);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.drawImage(0, 0, image);
+	painter.end();
 }
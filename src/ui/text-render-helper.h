@@ -1,7 +1,43 @@
 #ifndef TEXT_RENDER_HELPER_H
 #define TEXT_RENDER_HELPER_H
 
+#include "frame-buffer-pool.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class CustomTextDocument;
+
+struct text_document_deleter {
+	void operator()(CustomTextDocument *document) const;
+};
+
+// The text document of a mapping, kept across renders: the stylesheet is parsed once and only
+// the content is replaced on each render. Created, used and deleted on the render thread.
+struct text_render_document {
+	std::unique_ptr<CustomTextDocument, text_document_deleter> document;
+	std::string css_props;
+	bool has_stylesheet = false;
+};
+
+/**
+  * Fetch the http(s) images the text shows into the shared image cache, so the render doesn't
+  * wait on them. Call it before the render is submitted to the render thread, with the same
+  * width; the render then leaves out images that couldn't be fetched.
+  */
+void prefetch_text_images(const std::string &text, uint32_t width);
+
 void render_text_with_qtextdocument(const std::string &text, uint32_t &width, uint32_t &height,
-				    uint8_t **data, const std::string &css_props);
+				    frame_buffer &buffer, frame_buffer_pool &pool,
+				    const std::string &css_props, text_render_document &document);
+
+/**
+  * Decode an image into a buffer, scaled down to the width if it's wider.
+  * @param width In: the widest frame (0 for any width), out: the frame width
+  * @param height Out: the frame height, 0 if the image can't be decoded
+  */
+void render_image_to_buffer(const std::vector<uint8_t> &image_bytes, uint32_t &width,
+			    uint32_t &height, frame_buffer &buffer, frame_buffer_pool &pool);
 
 #endif // TEXT_RENDER_HELPER_H
@@ -2,12 +2,23 @@
 #include "url-source-callbacks.h"
 #include "url-source-data.h"
 #include "obs-source-util.h"
+#include "source-ref-cache.h"
+#include "output-store.h"
+#include "file-writer.h"
+#include "shm-output.h"
+#include "render-worker.h"
 #include "plugin-support.h"
 
 #include <obs-module.h>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <string_view>
 #include "ui/text-render-helper.h"
+#include "ui/glyph-atlas.h"
 #include <obs-frontend-api.h>
 
 void acquire_output_source_ref_by_name(const char *output_source_name, obs_source_t **output_source)
@@ -18,8 +29,8 @@ void acquire_output_source_ref_by_name(const char *output_source_name, obs_sourc
 		return;
 	}
 
-	// acquire a weak ref to the new text source
-	obs_source_t *source = obs_get_source_by_name(output_source_name);
+	// acquire a ref to the text source through the cache of weak refs
+	obs_source_t *source = get_cached_source_by_name(output_source_name);
 	if (source) {
 		*output_source = source;
 	} else {
@@ -28,13 +39,26 @@ void acquire_output_source_ref_by_name(const char *output_source_name, obs_sourc
 	}
 }
 
-void setTextCallback(const std::string &str, const output_mapping &mapping)
+/**
+  * Set the text of a mapping's output source (or the input of a media source)
+  * @param expected_target the source the update was made for. The name may refer to another
+  * source by the time the update runs, e.g. if it was removed and added again
+  * @return false if the source wasn't updated
+  */
+bool setTextCallback(const std::string &str, const output_mapping &mapping,
+		     obs_weak_source_t *expected_target)
 {
 	obs_source_t *target = nullptr;
 	acquire_output_source_ref_by_name(mapping.output_source.c_str(), &target);
 	if (target == nullptr) {
 		obs_log(LOG_ERROR, "Source target is null");
-		return;
+		return false;
+	}
+	if (!obs_weak_source_references_source(expected_target, target)) {
+		obs_log(LOG_WARNING, "Source '%s' was replaced, not updating it",
+			mapping.output_source.c_str());
+		obs_source_release(target);
+		return false;
 	}
 
 	obs_data_t *target_settings = obs_source_get_settings(target);
@@ -42,7 +66,7 @@ void setTextCallback(const std::string &str, const output_mapping &mapping)
 		obs_log(LOG_ERROR, "Failed to get settings for source '%s'",
 			mapping.output_source.c_str());
 		obs_source_release(target);
-		return;
+		return false;
 	}
 
 	if (strcmp(obs_source_get_id(target), "ffmpeg_source") == 0) {
@@ -60,24 +84,17 @@ void setTextCallback(const std::string &str, const output_mapping &mapping)
 	if (mapping.unhide_output_source) {
 		// unhide the output source
 		obs_source_set_enabled(target, true);
-		obs_enum_scenes(
-			[](void *target_ptr, obs_source_t *scene_source) -> bool {
-				obs_scene_t *scene = obs_scene_from_source(scene_source);
-				if (scene == nullptr) {
-					return true;
-				}
-				obs_sceneitem_t *scene_item = obs_scene_sceneitem_from_source(
-					scene, (obs_source_t *)target_ptr);
-				if (scene_item == nullptr) {
-					return true;
-				}
-				obs_sceneitem_set_visible(scene_item, true);
-				return false; // stop enumerating
-			},
-			target);
+		obs_source_t *scene_source = nullptr;
+		obs_sceneitem_t *scene_item =
+			get_cached_scene_item_by_name(mapping.output_source, &scene_source);
+		if (scene_item != nullptr) {
+			obs_sceneitem_set_visible(scene_item, true);
+		}
+		obs_source_release(scene_source);
 	}
 	obs_data_release(target_settings);
 	obs_source_release(target);
+	return true;
 };
 
 void setAudioCallback(const std::string &str, const output_mapping &mapping)
@@ -106,10 +123,13 @@ void setAudioCallback(const std::string &str, const output_mapping &mapping)
 	obs_source_release(target);
 };
 
-std::string renderOutputTemplate(inja::Environment &env, const std::string &input,
-				 const request_data_handler_response &response)
-try {
-	// Use Inja to render the template
+/**
+  * Build the inja data model for the output templates of a response.
+  * This is done once per response and shared by all the mappings. The parsed body
+  * is moved (not copied) into "body", so response.body_json is empty afterwards.
+  */
+nlohmann::json build_output_template_data(request_data_handler_response &response)
+{
 	nlohmann::json data;
 	if (response.body_parts_parsed.size() > 1) {
 		for (size_t i = 0; i < response.body_parts_parsed.size(); i++) {
@@ -125,49 +145,203 @@ try {
 			data[pair.first] = pair.second;
 		}
 	}
-	data["body"] = response.body_json;
-	return env.render(input, data);
+	data["body"] = std::move(response.body_json);
+	return data;
+}
+
+/**
+  * Render an output template
+  * @param rendered set to false if the template failed, the output is empty then
+  */
+std::string renderOutputTemplate(url_source_template_cache &templates, url_source_template &tmpl,
+				 const std::string &input, const nlohmann::json &data,
+				 bool &rendered)
+try {
+	// Use Inja to render the template
+	rendered = true;
+	return render_cached_template(templates, tmpl, input, data);
 } catch (std::exception &e) {
 	obs_log(LOG_ERROR, "Failed to parse template: %s", e.what());
+	rendered = false;
 	return "";
 }
 
+/**
+  * Upload a rendered frame to a layer's texture, drawn by video_render. This only happens when
+  * the layer's content changes, video_render draws the same textures every frame.
+  */
+void upload_render_layer(struct url_source_data *usd, const render_cache_entry &entry,
+			 size_t layer_index)
+{
+	obs_enter_graphics();
+	{
+		std::lock_guard<std::mutex> lock(usd->layers_mutex);
+		if (usd->layers.size() <= layer_index) {
+			usd->layers.resize(layer_index + 1);
+		}
+		render_layer &layer = usd->layers[layer_index];
+		layer.frame_id = entry.id;
+		layer.width = entry.width;
+		layer.height = entry.height;
+		if (entry.width > 0 && entry.height > 0) {
+			if (layer.texture != nullptr &&
+			    gs_texture_get_width(layer.texture) == entry.width &&
+			    gs_texture_get_height(layer.texture) == entry.height) {
+				gs_texture_set_image(layer.texture, entry.buffer.data,
+						     entry.width * 4, false);
+			} else {
+				gs_texture_destroy(layer.texture);
+				const uint8_t *texture_data = entry.buffer.data;
+				layer.texture = gs_texture_create(entry.width, entry.height,
+								  GS_BGRA, 1, &texture_data,
+								  GS_DYNAMIC);
+			}
+			if (layer.texture == nullptr) {
+				obs_log(LOG_ERROR, "Failed to create texture of %u x %u",
+					entry.width, entry.height);
+				layer.frame_id = 0;
+				layer.width = 0;
+				layer.height = 0;
+			}
+		}
+	}
+	obs_leave_graphics();
+}
+
+bool layer_shows_frame(struct url_source_data *usd, size_t layer_index,
+		       const render_cache_entry &entry)
+{
+	std::lock_guard<std::mutex> lock(usd->layers_mutex);
+	return layer_index < usd->layers.size() && usd->layers[layer_index].frame_id == entry.id;
+}
+
 void render_internal(const std::string &text, struct url_source_data *usd,
-		     const output_mapping &mapping)
+		     const output_mapping &mapping, text_render_document &document,
+		     size_t layer_index)
 {
-	uint8_t *renderBuffer = nullptr;
-	uint32_t width = usd->render_width;
-	uint32_t height = 0;
+	url_source_render_cache &cache = usd->render_cache;
+	// the marquee renders the text unwrapped and scrolls it
+	const bool marquee = usd->marquee;
+	const uint32_t requested_width = marquee ? 0 : usd->render_width;
+	render_cache_entry *entry =
+		render_cache_find(cache, text, mapping.css_props, requested_width);
+	if (entry != nullptr) {
+		usd->stats.render_cache_hits++;
+		if (layer_shows_frame(usd, layer_index, *entry)) {
+			// the layer is already showing this frame
+			return;
+		}
+	} else {
+		usd->stats.render_cache_misses++;
+		frame_buffer renderBuffer;
+		uint32_t width = requested_width;
+		uint32_t height = 0;
 
-	// render the text with QTextDocument
-	render_text_with_qtextdocument(text, width, height, &renderBuffer, mapping.css_props);
-	// Update the frame
-	usd->frame.data[0] = renderBuffer;
-	usd->frame.linesize[0] = width * 4;
-	usd->frame.width = width;
-	usd->frame.height = height;
+		// render the text (from cached glyphs if possible, or with QTextDocument) into a
+		// buffer from the cache's pool. This runs on the plugin's render thread, this
+		// thread waits so the pool isn't shared.
+		const render_priority priority = obs_source_showing(usd->source)
+							 ? RENDER_PRIORITY_VISIBLE
+							 : RENDER_PRIORITY_HIDDEN;
+		// images are fetched here, the render thread is shared by all sources and only
+		// lays out and paints
+		prefetch_text_images(text, width);
+		render_worker_submit(priority, [&]() {
+			if (usd->fast_text_render && !marquee &&
+			    render_text_with_glyph_atlas(text, width, height, renderBuffer,
+							 cache.pool, mapping.css_props)) {
+				return;
+			}
+			render_text_with_qtextdocument(text, width, height, renderBuffer,
+						       cache.pool, mapping.css_props, document);
+		}).get();
+		// the cache owns the buffer from here on
+		entry = &render_cache_insert(cache, text, mapping.css_props, requested_width,
+					     renderBuffer, width, height);
+	}
 
-	// Send the frame
-	obs_source_output_video(usd->source, &usd->frame);
+	upload_render_layer(usd, *entry, layer_index);
+}
 
-	bfree(usd->frame.data[0]);
-	usd->frame.data[0] = nullptr;
+/**
+  * Show an image output (image URL or image data) in a layer directly: the bytes are decoded
+  * once, scaled down to the render width if wider, and uploaded - no base64 data URI or HTML
+  * layout. Images are cached by content, so an unchanged image isn't decoded again.
+  */
+void render_image_internal(const std::vector<uint8_t> &image_bytes, struct url_source_data *usd,
+			   size_t layer_index)
+{
+	url_source_render_cache &cache = usd->render_cache;
+	const std::string key =
+		"image:" + std::to_string(image_bytes.size()) + ":" +
+		std::to_string(std::hash<std::string_view>{}(std::string_view(
+			reinterpret_cast<const char *>(image_bytes.data()), image_bytes.size())));
+	render_cache_entry *entry = render_cache_find(cache, key, "", usd->render_width);
+	if (entry != nullptr) {
+		usd->stats.render_cache_hits++;
+		if (layer_shows_frame(usd, layer_index, *entry)) {
+			return;
+		}
+	} else {
+		usd->stats.render_cache_misses++;
+		frame_buffer imageBuffer;
+		uint32_t width = usd->render_width;
+		uint32_t height = 0;
+		const render_priority priority = obs_source_showing(usd->source)
+							 ? RENDER_PRIORITY_VISIBLE
+							 : RENDER_PRIORITY_HIDDEN;
+		render_worker_submit(priority, [&]() {
+			render_image_to_buffer(image_bytes, width, height, imageBuffer, cache.pool);
+		}).get();
+		entry = &render_cache_insert(cache, key, "", usd->render_width, imageBuffer, width,
+					     height);
+	}
+	upload_render_layer(usd, *entry, layer_index);
+}
+
+/**
+  * Set the source size from the internal rendering layers of this output, stacked in mapping
+  * order, and drop the layers of mappings that aren't rendered internally anymore.
+  */
+void composite_render_layers(struct url_source_data *usd, size_t layer_count)
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	obs_enter_graphics();
+	{
+		std::lock_guard<std::mutex> lock(usd->layers_mutex);
+		while (usd->layers.size() > layer_count) {
+			gs_texture_destroy(usd->layers.back().texture);
+			usd->layers.pop_back();
+		}
+		for (const render_layer &layer : usd->layers) {
+			width = std::max(width, layer.width);
+			height += layer.height;
+		}
+	}
+	obs_leave_graphics();
+	usd->frame_width = width;
+	usd->frame_height = height;
 }
 
 std::string prepare_text_from_template(const output_mapping &mapping,
 				       const request_data_handler_response &response,
 				       const url_source_request_data &request,
-				       bool output_is_image_url)
+				       bool output_is_image_url, const nlohmann::json &data,
+				       url_source_template_cache &templates,
+				       url_source_template &tmpl, bool &rendered)
 {
+	rendered = true;
 	// prepare the text from the template
 	std::string text = mapping.template_string;
-	// if the template is empty use the response body
+	// if the template is empty use the response body (or the current ticker item)
 	if (text.empty()) {
+		if (data.at("output").is_string()) {
+			return data.at("output").get<std::string>();
+		}
 		return response.body_parts_parsed[0];
 	}
 
-	inja::Environment env;
-
 	// if output is image or image-URL - fetch the image and convert it to base64
 	if (output_is_image_url || request.output_type == "Image (data)") {
 		std::vector<uint8_t> image_data;
@@ -180,7 +354,7 @@ std::string prepare_text_from_template(const output_mapping &mapping,
 				mime_type = response.headers.at("content-type");
 			}
 		} else {
-			text = renderOutputTemplate(env, text, response);
+			text = renderOutputTemplate(templates, tmpl, text, data, rendered);
 			// use fetch_image to get the image
 			image_data = fetch_image(text.c_str(), mime_type);
 		}
@@ -189,7 +363,7 @@ std::string prepare_text_from_template(const output_mapping &mapping,
 		// build an image tag with the base64 image
 		text = "<img src=\"data:" + mime_type + ";base64," + base64_image + "\" />";
 	} else {
-		text = renderOutputTemplate(env, text, response);
+		text = renderOutputTemplate(templates, tmpl, text, data, rendered);
 	}
 	return text;
 }
@@ -201,16 +375,158 @@ void save_text_to_file(const std::string &text, const std::string &file_path)
 		obs_log(LOG_ERROR, "No file path specified");
 		return;
 	}
-	std::ofstream file(file_path);
-	if (!file.is_open()) {
-		obs_log(LOG_ERROR, "Failed to open file '%s'", file_path.c_str());
-		return;
+	// written asynchronously (and atomically) by the file writer thread
+	file_writer_write(file_path, text);
+}
+
+bool is_internal_rendering_mapping(const output_mapping &mapping)
+{
+	return !is_valid_output_source_name(mapping.output_source.c_str()) ||
+	       mapping.output_source == none_internal_rendering;
+}
+
+bool has_internal_rendering_mapping(struct url_source_data *usd)
+{
+	std::unique_lock<std::mutex> lock(usd->output_mapping_mutex);
+	for (const output_mapping &mapping : usd->output_mapping_data.mappings) {
+		if (is_internal_rendering_mapping(mapping)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+  * Check if a mapping must be rendered again: its settings changed or any of the values its
+  * template reads changed since the last output. The state isn't changed, the values the
+  * template reads now (pointing into data) are returned for commit_mapping_render.
+  */
+bool mapping_needs_render(const output_mapping_state &state, const output_mapping &mapping,
+			  url_source_template &tmpl, struct url_source_data *usd,
+			  const nlohmann::json &data,
+			  std::vector<const nlohmann::json *> &dependency_values)
+{
+	static const std::vector<nlohmann::json::json_pointer> output_only = {
+		nlohmann::json::json_pointer("/output")};
+	static const nlohmann::json missing_value;
+
+	bool changed = !state.has_output || state.mapping != mapping ||
+		       state.output_type != usd->request_data.output_type ||
+		       state.render_width != usd->render_width;
+	// images are fetched or taken from the response bytes, which aren't tracked
+	if (usd->output_is_image_url || usd->request_data.output_type == "Image (data)") {
+		changed = true;
+	}
+
+	// an empty template outputs the first parsed value
+	const std::vector<nlohmann::json::json_pointer> *dependencies = &output_only;
+	if (!mapping.template_string.empty()) {
+		if (!compile_cached_template(usd->templates, tmpl, mapping.template_string) ||
+		    tmpl.always_render) {
+			changed = true;
+		}
+		dependencies = &tmpl.dependencies;
+	}
+
+	dependency_values.clear();
+	for (size_t i = 0; i < dependencies->size(); i++) {
+		const nlohmann::json::json_pointer &pointer = (*dependencies)[i];
+		const nlohmann::json &value = data.contains(pointer) ? data.at(pointer)
+								     : missing_value;
+		dependency_values.push_back(&value);
+		if (i >= state.dependency_values.size() || state.dependency_values[i] != value) {
+			changed = true;
+		}
 	}
-	file << text;
-	file.close();
+	return changed;
 }
 
-void output_with_mapping(const request_data_handler_response &response, struct url_source_data *usd)
+/**
+  * Record what a mapping's output was produced from, so it isn't rendered again until that
+  * changes. Only called once the output was rendered and delivered.
+  */
+void commit_mapping_render(output_mapping_state &state, const output_mapping &mapping,
+			   struct url_source_data *usd,
+			   const std::vector<const nlohmann::json *> &dependency_values)
+{
+	state.dependency_values.resize(dependency_values.size());
+	for (size_t i = 0; i < dependency_values.size(); i++) {
+		if (state.dependency_values[i] != *dependency_values[i]) {
+			state.dependency_values[i] = *dependency_values[i];
+		}
+	}
+	state.has_output = true;
+	state.mapping = mapping;
+	state.output_type = usd->request_data.output_type;
+	state.render_width = usd->render_width;
+}
+
+// OBS source updates from one response. They are committed together in a single graphics task,
+// so the updates of a multi-field overlay land in the same frame.
+struct output_commit_batch {
+	std::vector<std::function<void()>> updates;
+	// the sources the updates are for, released with the batch
+	std::vector<obs_weak_source_t *> targets;
+
+	~output_commit_batch()
+	{
+		for (obs_weak_source_t *target : targets) {
+			obs_weak_source_release(target);
+		}
+	}
+};
+
+bool is_delivered(output_delivery &delivery, const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(delivery.mutex);
+	return delivery.has_delivered && delivery.text == text;
+}
+
+void record_delivery(output_delivery &delivery, const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(delivery.mutex);
+	delivery.text = text;
+	delivery.has_delivered = true;
+}
+
+// Record the outcome of an output source update, in the graphics task that made it
+void record_source_update(output_delivery &delivery, const std::string &text, bool updated)
+{
+	std::lock_guard<std::mutex> lock(delivery.mutex);
+	if (updated) {
+		delivery.text = text;
+		delivery.has_delivered = true;
+		delivery.updates_made++;
+	} else {
+		delivery.update_failed = true;
+	}
+}
+
+/**
+  * Take the outcomes of the source updates made since the last call
+  * @param updates_made the number of updates made
+  * @return false if an update failed
+  */
+bool take_source_updates(output_delivery &delivery, uint64_t &updates_made)
+{
+	std::lock_guard<std::mutex> lock(delivery.mutex);
+	updates_made = delivery.updates_made;
+	delivery.updates_made = 0;
+	const bool failed = delivery.update_failed;
+	delivery.update_failed = false;
+	return !failed;
+}
+
+void commit_output_batch(void *data)
+{
+	std::unique_ptr<output_commit_batch> batch(static_cast<output_commit_batch *>(data));
+	for (const auto &update : batch->updates) {
+		update();
+	}
+}
+
+void output_with_template_data(const request_data_handler_response &response,
+			       const nlohmann::json &data, struct url_source_data *usd)
 {
 	std::vector<output_mapping> mappings;
 
@@ -227,20 +543,94 @@ void output_with_mapping(const request_data_handler_response &response, struct u
 		return;
 	}
 
-	bool any_internal_rendering = false;
+	// keep one compiled output template and state per mapping
+	usd->templates.outputs.resize(mappings.size());
+	usd->output_mapping_states.resize(mappings.size());
+
+	// source updates are collected here and committed at once after all mappings are done
+	std::unique_ptr<output_commit_batch> batch(new output_commit_batch);
+
+	// internally rendered mappings, each gets its own layer of the source's frame
+	size_t layer_count = 0;
+	// the values the current mapping's template reads, see mapping_needs_render
+	std::vector<const nlohmann::json *> dependency_values;
 	// iterate over the mappings and output the text with each one
-	for (const auto &mapping : mappings) {
+	for (size_t i = 0; i < mappings.size(); i++) {
+		const output_mapping &mapping = mappings[i];
 		if (usd->request_data.output_type == "Audio (data)") {
-			if (!is_valid_output_source_name(mapping.output_source.c_str())) {
-				obs_log(LOG_ERROR, "Must select an output source for audio output");
+			// internally rendered mappings already played the audio through the
+			// source's own output while it downloaded (see curl_loop)
+			if (!is_internal_rendering_mapping(mapping)) {
+				batch->updates.push_back([audio_file = response.body, mapping]() {
+					setAudioCallback(audio_file, mapping);
+				});
+			}
+			continue;
+		}
+
+		output_mapping_state &mapping_state = usd->output_mapping_states[i];
+		if (!is_internal_rendering_mapping(mapping)) {
+			mapping_state.layer_index = SIZE_MAX;
+		} else if (mapping_state.layer_index != layer_count) {
+			// layers are stacked by position: an earlier mapping gained or lost its
+			// layer, so this mapping's layer moved and holds another mapping's frame
+			mapping_state.layer_index = layer_count;
+			mapping_state.has_output = false;
+		}
+		uint64_t updates_made = 0;
+		if (!take_source_updates(*mapping_state.delivery, updates_made)) {
+			// the last update of the output source failed - render and make it again
+			mapping_state.has_output = false;
+		}
+		usd->stats.outputs_updated += updates_made;
+		if (mapping_state.mapping != mapping) {
+			// the target may have changed - deliver the next output even if it's the
+			// same text. Updates pending for the old target record into the old one
+			mapping_state.delivery = std::make_shared<output_delivery>();
+		}
+
+		if (!mapping_needs_render(mapping_state, mapping, usd->templates.outputs[i], usd,
+					  data, dependency_values)) {
+			// nothing this mapping reads has changed - keep its last output
+			usd->stats.renders_skipped++;
+			if (is_internal_rendering_mapping(mapping)) {
+				// its layer stays as it is
+				layer_count++;
+			}
+			continue;
+		}
+
+		if (is_internal_rendering_mapping(mapping) &&
+		    (usd->output_is_image_url || usd->request_data.output_type == "Image (data)")) {
+			// show the image itself in this mapping's layer
+			bool rendered = true;
+			if (usd->request_data.output_type == "Image (data)") {
+				render_image_internal(response.body_bytes, usd, layer_count++);
 			} else {
-				setAudioCallback(response.body, mapping);
+				const std::string image_url =
+					mapping.template_string.empty()
+						? response.body_parts_parsed[0]
+						: renderOutputTemplate(usd->templates,
+								       usd->templates.outputs[i],
+								       mapping.template_string,
+								       data, rendered);
+				std::string mime_type;
+				render_image_internal(fetch_image(image_url, mime_type), usd,
+						      layer_count++);
+			}
+			if (rendered) {
+				commit_mapping_render(mapping_state, mapping, usd,
+						      dependency_values);
 			}
 			continue;
 		}
 
+		// a failed template or delivery isn't committed, so it's tried again next time
+		bool delivered = true;
 		std::string text = prepare_text_from_template(mapping, response, usd->request_data,
-							      usd->output_is_image_url);
+							      usd->output_is_image_url, data,
+							      usd->templates,
+							      usd->templates.outputs[i], delivered);
 
 		if (usd->send_to_stream && !usd->output_is_image_url) {
 			// Send the output to the current stream as caption, if it's not an image and a stream is open
@@ -251,37 +641,118 @@ void output_with_mapping(const request_data_handler_response &response, struct u
 			}
 		}
 
+		const std::shared_ptr<output_delivery> delivery = mapping_state.delivery;
+		if (!is_internal_rendering_mapping(mapping)) {
+			// don't update the target source / file if it already has this text
+			if (is_delivered(*delivery, text)) {
+				usd->stats.outputs_skipped++;
+				if (delivered) {
+					commit_mapping_render(mapping_state, mapping, usd,
+							      dependency_values);
+				}
+				continue;
+			}
+		}
+
 		if (is_valid_output_source_name(mapping.output_source.c_str()) &&
 		    mapping.output_source != none_internal_rendering &&
 		    mapping.output_source != file_output_rendering &&
-		    mapping.output_source != save_to_setting) {
-			// If an output source is selected - use it for rendering
-			setTextCallback(text, mapping);
+		    mapping.output_source != publish_to_output_channel &&
+		    mapping.output_source != shared_memory_output) {
+			// If an output source is selected - use it for rendering. The text is
+			// delivered once the update is made, a failed one is taken on the next
+			// output (take_source_updates) and made again
+			obs_source_t *target = get_cached_source_by_name(mapping.output_source);
+			if (target == nullptr) {
+				obs_log(LOG_ERROR, "Source '%s' not found",
+					mapping.output_source.c_str());
+				continue;
+			}
+			obs_weak_source_t *weak_target = obs_source_get_weak_source(target);
+			obs_source_release(target);
+			batch->targets.push_back(weak_target);
+			batch->updates.push_back([text, mapping, delivery, weak_target]() {
+				record_source_update(*delivery, text,
+						     setTextCallback(text, mapping, weak_target));
+			});
 		} else {
-			if (mapping.output_source == save_to_setting) {
-				// If the output source is set to save to settings - save the text to the source settings
-				obs_data_t *source_settings = obs_source_get_settings(usd->source);
-				if (source_settings == nullptr) {
-					obs_log(LOG_ERROR, "Failed to get settings for source");
-				} else {
-					obs_data_set_string(source_settings, "output",
-							    text.c_str());
-					obs_source_update(usd->source, source_settings);
-					obs_data_release(source_settings);
-				}
+			if (mapping.output_source == publish_to_output_channel) {
+				// publish the text on the source's output channel (get_output proc and
+				// output_changed signal). This doesn't update the source settings.
+				output_store_publish(usd, mapping.name, text);
+				record_delivery(*delivery, text);
+				usd->stats.outputs_updated++;
 			} else if (mapping.output_source == file_output_rendering) {
 				// If the output source is set to file output - save the text to a file
 				save_text_to_file(text, mapping.file_path);
+				record_delivery(*delivery, text);
+				usd->stats.outputs_updated++;
+			} else if (mapping.output_source == shared_memory_output) {
+				// publish the text to local consumers through shared memory
+				const std::string shm_name = shm_output_name_for_mapping(
+					obs_source_get_name(usd->source), mapping.name);
+				if (shm_output_publish(shm_name, text)) {
+					record_delivery(*delivery, text);
+					usd->stats.outputs_updated++;
+				} else {
+					delivered = false;
+				}
 			} else {
-				// render the text internally
-				any_internal_rendering = true;
-				render_internal(text, usd, mapping);
+				// render the text internally, into this mapping's layer
+				render_internal(text, usd, mapping,
+						usd->output_mapping_states[i].render_document,
+						layer_count++);
 			}
 		} // end if not text source
+		if (delivered) {
+			commit_mapping_render(mapping_state, mapping, usd, dependency_values);
+		}
+	}
+
+	if (!batch->updates.empty()) {
+		// commit all source updates of this response on the graphics thread, in one go
+		obs_queue_task(OBS_TASK_GRAPHICS, commit_output_batch, batch.release(), false);
 	}
 
-	if (!any_internal_rendering) {
-		// Send a null frame to hide the source
-		obs_source_output_video(usd->source, nullptr);
+	// composite the layers into the source's frame, with no layers the source is hidden
+	composite_render_layers(usd, layer_count);
+}
+
+void output_with_mapping(request_data_handler_response &response, struct url_source_data *usd)
+{
+	// build the template data once and share it across all mappings
+	const nlohmann::json data = build_output_template_data(response);
+	output_with_template_data(response, data, usd);
+}
+
+void output_ticker_with_mapping(request_data_handler_response &response,
+				struct url_source_data *usd, uint64_t until_ns)
+{
+	const size_t count = response.body_parts_parsed.size();
+	nlohmann::json data = build_output_template_data(response);
+	data["ticker_count"] = count;
+
+	while (usd->curl_thread_run) {
+		const uint64_t now_ns = get_time_ns();
+		if (now_ns >= usd->ticker_next_ns) {
+			// show the next item as "output". The rotation carries on across fetches
+			const size_t index = usd->ticker_index++ % count;
+			data["output"] = response.body_parts_parsed[index];
+			data["ticker_index"] = index;
+			output_with_template_data(response, data, usd);
+			usd->ticker_next_ns = now_ns + (uint64_t)usd->ticker_interval_ms * 1000000;
+		}
+
+		const uint64_t wake_ns = std::min(usd->ticker_next_ns, until_ns);
+		const uint64_t after_output_ns = get_time_ns();
+		if (after_output_ns >= until_ns) {
+			// time for the next fetch
+			break;
+		}
+		if (wake_ns > after_output_ns) {
+			std::unique_lock<std::mutex> lock(usd->curl_mutex);
+			usd->curl_thread_cv.wait_for(
+				lock, std::chrono::nanoseconds(wake_ns - after_output_ns));
+		}
 	}
 }
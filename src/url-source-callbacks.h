@@ -5,11 +5,18 @@
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
-#include <inja/inja.hpp>
 
 #include "request-data.h"
 
-void output_with_mapping(const request_data_handler_response &response,
-			 struct url_source_data *usd);
+void output_with_mapping(request_data_handler_response &response, struct url_source_data *usd);
+
+// Ticker mode: output the parsed items of the response one at a time, one every ticker interval,
+// until until_ns (the time of the next fetch). Each item goes through the mapping templates as
+// "output", along with "ticker_index" and "ticker_count".
+void output_ticker_with_mapping(request_data_handler_response &response,
+				struct url_source_data *usd, uint64_t until_ns);
+
+// Check if any mapping renders internally, i.e. into the URL source itself
+bool has_internal_rendering_mapping(struct url_source_data *usd);
 
 #endif
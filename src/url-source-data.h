@@ -3,13 +3,92 @@
 
 #include "request-data.h"
 #include "mapping-data.h"
+#include "template-cache.h"
+#include "render-cache.h"
+#include "audio-player.h"
+#include "ui/text-render-helper.h"
 
 #include <obs-module.h>
 #include <string>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
 #include <atomic>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// The text last delivered to a mapping's output source / file / setting. Source updates are
+// recorded by the graphics task that made them, once they succeeded.
+struct output_delivery {
+	std::mutex mutex;
+	bool has_delivered = false;
+	std::string text;
+	// source updates made and failed by the graphics task, taken by the curl thread
+	uint64_t updates_made = 0;
+	bool update_failed = false;
+};
+
+// Runtime state of an output mapping between ticks. Only accessed from the curl thread.
+struct output_mapping_state {
+	bool has_output = false;
+	// settings the last output was produced with
+	output_mapping mapping;
+	std::string output_type;
+	uint32_t render_width = 0;
+	// values of the template's dependencies when the last output was produced
+	std::vector<nlohmann::json> dependency_values;
+	// shared with the pending updates of the output, replaced when the mapping changes
+	std::shared_ptr<output_delivery> delivery = std::make_shared<output_delivery>();
+	// kept for internal rendering, only used on the render thread
+	text_render_document render_document;
+	// the layer this mapping rendered into last, SIZE_MAX if it doesn't render internally
+	size_t layer_index = SIZE_MAX;
+};
+
+// The frame of one internally rendered mapping, drawn in video_render. Layers are stacked top
+// to bottom in mapping order. Guarded by url_source_data::layers_mutex.
+struct render_layer {
+	gs_texture_t *texture = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// id of the render cache entry in the texture
+	uint64_t frame_id = 0;
+	// marquee scroll position, only used on the graphics thread
+	float marquee_offset = 0.0f;
+};
+
+// Per-source counters, shown in the source properties
+struct url_source_stats {
+	std::atomic<uint64_t> requests{0};
+	// mappings not rendered since none of their template inputs changed
+	std::atomic<uint64_t> renders_skipped{0};
+	// output source / file updates done, and skipped since the text didn't change
+	std::atomic<uint64_t> outputs_updated{0};
+	std::atomic<uint64_t> outputs_skipped{0};
+	// internal renders served from the render cache, and actually rendered
+	std::atomic<uint64_t> render_cache_hits{0};
+	std::atomic<uint64_t> render_cache_misses{0};
+};
+
+// Latest text of each "Publish to output channel" mapping, by mapping name. Read by other plugins
+// and scripts through the source's proc handler (get_output / get_outputs).
+struct url_source_output_store {
+	std::mutex mutex;
+	std::map<std::string, std::string> outputs;
+};
+
+inline std::string format_url_source_stats(const url_source_stats &stats)
+{
+	return "Requests: " + std::to_string(stats.requests.load()) +
+	       ", renders skipped (unchanged inputs): " +
+	       std::to_string(stats.renders_skipped.load()) +
+	       ", outputs updated: " + std::to_string(stats.outputs_updated.load()) +
+	       ", outputs skipped (same text): " + std::to_string(stats.outputs_skipped.load()) +
+	       ", render cache hits: " + std::to_string(stats.render_cache_hits.load()) + "/" +
+	       std::to_string(stats.render_cache_hits.load() + stats.render_cache_misses.load());
+}
 
 struct url_source_data {
 	obs_source_t *source = nullptr;
@@ -19,9 +98,36 @@ struct url_source_data {
 	uint32_t update_timer_ms = 1000;
 	bool run_while_not_visible = false;
 	bool output_is_image_url = false;
-	struct obs_source_frame frame;
+	// internally rendered mappings, composited in video_render
+	std::vector<render_layer> layers;
+	// taken by video_tick, video_render and the curl thread's uploads. Inside the graphics
+	// context when both are needed.
+	std::mutex layers_mutex;
+	// size of the composited layers, 0 while nothing is rendered internally (source hidden)
+	std::atomic<uint32_t> frame_width{0};
+	std::atomic<uint32_t> frame_height{0};
 	bool send_to_stream = false;
 	uint32_t render_width = 640;
+	// render short plain text from cached glyphs instead of a full document layout
+	bool fast_text_render = false;
+	// marquee: render the text on one line and scroll it on the GPU, speed in pixels/second
+	bool marquee = false;
+	uint32_t marquee_speed = 120;
+	// ticker mode: show the parsed items one at a time between fetches
+	bool ticker_mode = false;
+	uint32_t ticker_interval_ms = 5000;
+	// ticker position, only accessed from the curl thread
+	size_t ticker_index = 0;
+	uint64_t ticker_next_ns = 0;
+	// compiled templates, only accessed from the curl thread
+	url_source_template_cache templates;
+	std::vector<output_mapping_state> output_mapping_states;
+	// frames rendered internally, only accessed from the curl thread
+	url_source_render_cache render_cache;
+	// plays "Audio (data)" responses of internally rendered mappings
+	url_source_audio_player *audio_player = nullptr;
+	struct url_source_stats stats;
+	struct url_source_output_store output_store;
 
 	std::mutex output_mapping_mutex;
 	std::mutex curl_mutex;
@@ -3,7 +3,7 @@
 struct obs_source_info url_source = {
 	.id = "url_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_AUDIO,
 	.get_name = url_source_name,
 	.create = url_source_create,
 	.destroy = url_source_destroy,
@@ -12,4 +12,8 @@ struct obs_source_info url_source = {
 	.update = url_source_update,
 	.activate = url_source_activate,
 	.deactivate = url_source_deactivate,
+	.get_width = url_source_get_width,
+	.get_height = url_source_get_height,
+	.video_render = url_source_video_render,
+	.video_tick = url_source_video_tick,
 };
@@ -0,0 +1,105 @@
+/*
+URL Source shared memory output - layout and reader.
+
+This header is self-contained (C99 / C++) so external consumers can copy it and read the
+"Shared memory output" of URL Source mappings without linking to anything.
+
+Each mapping publishes into a named shared memory object (POSIX shm_open name, or a
+"Local\" file mapping name on Windows) holding a ring of URL_SOURCE_SHM_SLOTS messages.
+Every message gets an increasing sequence number; write_sequence is the sequence number of the
+last complete message, which lives in slots[write_sequence % URL_SOURCE_SHM_SLOTS].
+
+Slots are guarded by a sequence lock: slot.sequence is 2*seq+1 while a message is written and
+2*seq once it's complete. A reader can use the slot data in place (zero-copy) and then check
+that slot.sequence didn't change, or copy it out with url_source_shm_read_latest().
+*/
+
+#ifndef URL_SOURCE_SHM_H
+#define URL_SOURCE_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define URL_SOURCE_SHM_FENCE() MemoryBarrier()
+#else
+#define URL_SOURCE_SHM_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define URL_SOURCE_SHM_MAGIC 0x534C5255u /* "URLS" */
+#define URL_SOURCE_SHM_VERSION 1u
+#define URL_SOURCE_SHM_SLOTS 8u
+#define URL_SOURCE_SHM_SLOT_SIZE (64u * 1024u)
+
+struct url_source_shm_slot {
+	volatile uint64_t sequence;
+	uint32_t size;
+	uint32_t reserved;
+	uint8_t data[URL_SOURCE_SHM_SLOT_SIZE];
+};
+
+struct url_source_shm_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	volatile uint64_t write_sequence;
+	struct url_source_shm_slot slots[URL_SOURCE_SHM_SLOTS];
+};
+
+/**
+  * Copy the latest message out of a mapped buffer.
+  * @param shm the mapped shared memory
+  * @param buffer destination, should hold URL_SOURCE_SHM_SLOT_SIZE bytes
+  * @param capacity size of buffer
+  * @param sequence in: the last sequence number the caller has seen (0 for none),
+  *                 out: the sequence number of the returned message
+  * @return the message size, 0 if there's no new message, or -1 if the buffer is invalid
+  */
+static inline int64_t url_source_shm_read_latest(const struct url_source_shm_header *shm,
+						 uint8_t *buffer, uint32_t capacity,
+						 uint64_t *sequence)
+{
+	if (shm->magic != URL_SOURCE_SHM_MAGIC || shm->version != URL_SOURCE_SHM_VERSION) {
+		return -1;
+	}
+	for (int attempt = 0; attempt < 16; attempt++) {
+		const uint64_t seq = shm->write_sequence;
+		URL_SOURCE_SHM_FENCE();
+		if (seq == 0 || seq == *sequence) {
+			return 0;
+		}
+		const struct url_source_shm_slot *slot = &shm->slots[seq % URL_SOURCE_SHM_SLOTS];
+		const uint64_t before = slot->sequence;
+		URL_SOURCE_SHM_FENCE();
+		if (before != seq * 2) {
+			// overwritten by a newer message - retry with that one
+			continue;
+		}
+		uint32_t size = slot->size;
+		if (size > capacity) {
+			size = capacity;
+		}
+		memcpy(buffer, slot->data, size);
+		URL_SOURCE_SHM_FENCE();
+		if (slot->sequence == before) {
+			*sequence = seq;
+			return (int64_t)size;
+		}
+	}
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URL_SOURCE_SHM_H */
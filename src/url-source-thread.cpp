@@ -2,6 +2,7 @@
 #include "url-source-thread.h"
 #include "url-source-callbacks.h"
 #include "request-data.h"
+#include "audio-player.h"
 #include "plugin-support.h"
 #include "obs-source-util.h"
 #include "ui/text-render-helper.h"
@@ -9,21 +10,58 @@
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 #include <obs-source.h>
-#include <inja/inja.hpp>
 
 void curl_loop(struct url_source_data *usd)
 {
 	obs_log(LOG_INFO, "Starting URL Source thread, update timer: %d", usd->update_timer_ms);
 
-	inja::Environment env;
-
 	while (usd->curl_thread_run) {
 		// time the request
 		uint64_t request_start_time_ns = get_time_ns();
 
+		// Audio of internally rendered mappings plays through the source's own audio
+		// output, decoded while the response downloads
+		const bool play_audio = usd->request_data.output_type == "Audio (data)" &&
+					has_internal_rendering_mapping(usd);
+		// the clip starts with the first bytes of a successful response, so requests that
+		// are skipped or fail don't stop the clip that's still playing
+		bool audio_started = false;
+		request_body_stream body_stream;
+		if (play_audio) {
+			body_stream = [usd, &audio_started](const uint8_t *data, size_t size) {
+				if (!audio_started) {
+					audio_player_begin(usd->audio_player);
+					audio_started = true;
+				}
+				audio_player_write(usd->audio_player, data, size);
+			};
+		}
+
 		// Send the request
-		struct request_data_handler_response response =
-			request_data_handler(&(usd->request_data));
+		struct request_data_handler_response response = request_data_handler(
+			&(usd->request_data), &(usd->templates), body_stream);
+		if (play_audio && !audio_started &&
+		    response.status_code == URL_SOURCE_REQUEST_SUCCESS &&
+		    !response.body_bytes.empty()) {
+			// not an HTTP download (e.g. a WebSocket message), play it at once
+			audio_player_begin(usd->audio_player);
+			audio_player_write(usd->audio_player, response.body_bytes.data(),
+					   response.body_bytes.size());
+			audio_started = true;
+		}
+		if (audio_started) {
+			audio_player_end(usd->audio_player);
+		}
+		usd->stats.requests++;
+		for (input_data &input : usd->request_data.inputs) {
+			// the next image inputs are compared to the last ones that were sent
+			if (response.status_code == URL_SOURCE_REQUEST_SUCCESS &&
+			    !input.pending_image_thumbnail.empty()) {
+				input.last_image_thumbnail =
+					std::move(input.pending_image_thumbnail);
+			}
+			input.pending_image_thumbnail.clear();
+		}
 		if (response.status_code != URL_SOURCE_REQUEST_SUCCESS) {
 			if (response.status_code != URL_SOURCE_REQUEST_BENIGN_ERROR_CODE) {
 				obs_log(LOG_INFO, "Failed to send request: %s",
@@ -34,7 +72,15 @@ void curl_loop(struct url_source_data *usd)
 				response.body_parts_parsed.push_back(response.body);
 			}
 
-			output_with_mapping(response, usd);
+			if (usd->ticker_mode && response.body_parts_parsed.size() > 1) {
+				// rotate through the items on the ticker clock until the next fetch
+				const uint64_t next_fetch_ns =
+					request_start_time_ns +
+					(uint64_t)usd->update_timer_ms * 1000000;
+				output_ticker_with_mapping(response, usd, next_fetch_ns);
+			} else {
+				output_with_mapping(response, usd);
+			}
 		}
 
 		// time the request, calculate the remaining time and sleep
@@ -49,7 +95,8 @@ void curl_loop(struct url_source_data *usd)
 						     std::chrono::milliseconds(sleep_time_ms));
 		}
 	}
-	obs_log(LOG_INFO, "Stopping URL Source thread");
+	obs_log(LOG_INFO, "Stopping URL Source thread. %s",
+		format_url_source_stats(usd->stats).c_str());
 }
 
 void stop_and_join_curl_thread(struct url_source_data *usd)
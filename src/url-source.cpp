@@ -18,6 +18,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #include "ui/RequestBuilder.h"
 #include "ui/text-render-helper.h"
+#include "ui/CustomTextDocument.h"
 #include "ui/outputmapping.h"
 #include "request-data.h"
 #include "plugin-support.h"
@@ -27,6 +28,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include "url-source-callbacks.h"
 #include "obs-source-util.h"
 #include "mapping-data.h"
+#include "output-store.h"
 
 #include <stdlib.h>
 #include <graphics/graphics.h>
@@ -34,6 +36,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-frontend-api.h>
 #include <inja/inja.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <thread>
 #include <mutex>
 #include <chrono>
@@ -53,12 +57,19 @@ void url_source_destroy(void *data)
 	struct url_source_data *usd = reinterpret_cast<struct url_source_data *>(data);
 
 	stop_and_join_curl_thread(usd);
-
-	if (usd->frame.data[0] != nullptr) {
-		bfree(usd->frame.data[0]);
-		usd->frame.data[0] = nullptr;
+	audio_player_destroy(usd->audio_player);
+
+	obs_enter_graphics();
+	{
+		std::lock_guard<std::mutex> lock(usd->layers_mutex);
+		for (render_layer &layer : usd->layers) {
+			gs_texture_destroy(layer.texture);
+		}
+		usd->layers.clear();
 	}
+	obs_leave_graphics();
 
+	usd->~url_source_data();
 	bfree(usd);
 }
 
@@ -79,9 +90,7 @@ void *url_source_create(obs_data_t *settings, obs_source_t *source)
 	struct url_source_data *usd = new (p) url_source_data();
 	usd->source = source;
 	usd->request_data = url_source_request_data();
-
-	usd->frame.data[0] = nullptr;
-	usd->frame.format = VIDEO_FORMAT_BGRA;
+	usd->audio_player = audio_player_create(source);
 
 	// get request data from settings
 	std::string serialized_request_data = obs_data_get_string(settings, "request_data");
@@ -106,6 +115,13 @@ void *url_source_create(obs_data_t *settings, obs_source_t *source)
 	usd->run_while_not_visible = obs_data_get_bool(settings, "run_while_not_visible");
 	usd->output_is_image_url = obs_data_get_bool(settings, "is_image_url");
 	usd->send_to_stream = obs_data_get_bool(settings, "send_to_stream");
+	usd->fast_text_render = obs_data_get_bool(settings, "fast_text_render");
+	usd->marquee = obs_data_get_bool(settings, "marquee");
+	usd->marquee_speed = (uint32_t)obs_data_get_int(settings, "marquee_speed");
+	usd->ticker_mode = obs_data_get_bool(settings, "ticker_mode");
+	usd->ticker_interval_ms = (uint32_t)obs_data_get_int(settings, "ticker_interval");
+
+	output_store_register(usd);
 
 	if (obs_source_active(source) && obs_source_showing(source)) {
 		// start the thread
@@ -128,6 +144,11 @@ void url_source_update(void *data, obs_data_t *settings)
 	usd->run_while_not_visible = obs_data_get_bool(settings, "run_while_not_visible");
 	usd->output_is_image_url = obs_data_get_bool(settings, "is_image_url");
 	usd->send_to_stream = obs_data_get_bool(settings, "send_to_stream");
+	usd->fast_text_render = obs_data_get_bool(settings, "fast_text_render");
+	usd->marquee = obs_data_get_bool(settings, "marquee");
+	usd->marquee_speed = (uint32_t)obs_data_get_int(settings, "marquee_speed");
+	usd->ticker_mode = obs_data_get_bool(settings, "ticker_mode");
+	usd->ticker_interval_ms = (uint32_t)obs_data_get_int(settings, "ticker_interval");
 	usd->render_width = (uint32_t)obs_data_get_int(settings, "render_width");
 	usd->output_mapping_data = deserialize_output_mapping_data(
 		obs_data_get_string(settings, "output_mapping_data"));
@@ -168,6 +189,10 @@ void url_source_defaults(obs_data_t *s)
 
 	obs_data_set_default_bool(s, "run_while_not_visible", false);
 
+	// Ticker mode off by default, rotating every 5 seconds when on
+	obs_data_set_default_bool(s, "ticker_mode", false);
+	obs_data_set_default_int(s, "ticker_interval", 5000);
+
 	// Is Image URL default false
 	obs_data_set_default_bool(s, "is_image_url", false);
 
@@ -181,6 +206,13 @@ void url_source_defaults(obs_data_t *s)
 
 	// Default Render Width
 	obs_data_set_default_int(s, "render_width", 640);
+
+	// Fast rendering of short plain text off by default
+	obs_data_set_default_bool(s, "fast_text_render", false);
+
+	// Marquee off by default, scrolling at 120 pixels per second when on
+	obs_data_set_default_bool(s, "marquee", false);
+	obs_data_set_default_int(s, "marquee_speed", 120);
 }
 
 bool setup_request_button_click(obs_properties_t *, obs_property_t *, void *button_data)
@@ -207,7 +239,7 @@ bool output_mapping_and_template_button_click(obs_properties_t *, obs_property_t
 		reinterpret_cast<struct url_source_data *>(button_data);
 	// Open the Output Mapping dialog
 	std::unique_ptr<OutputMapping> output_mapping(new OutputMapping(
-		button_usd->output_mapping_data,
+		button_usd->output_mapping_data, obs_source_get_name(button_usd->source),
 		[button_usd](const output_mapping_data &new_mapping_data) {
 			if (button_usd->source == nullptr) {
 				obs_log(LOG_ERROR, "Source is null");
@@ -262,6 +294,11 @@ obs_properties_t *url_source_properties(void *data)
 	// Update timer setting in milliseconds
 	obs_properties_add_int(ppts, "update_timer", MT_("update_timer_ms"), 100, 1000000, 100);
 
+	// Ticker mode: fetch on the update timer, rotate through the parsed items faster
+	obs_properties_add_bool(ppts, "ticker_mode", MT_("ticker_mode"));
+	obs_properties_add_int(ppts, "ticker_interval", MT_("ticker_interval_ms"), 100, 1000000,
+			       100);
+
 	// Run timer while not visible
 	obs_properties_add_bool(ppts, "run_while_not_visible", MT_("run_while_not_visible"));
 
@@ -272,6 +309,21 @@ obs_properties_t *url_source_properties(void *data)
 
 	obs_properties_add_int(ppts, "render_width", MT_("render_width"), 100, 10000, 1);
 
+	// Render short plain text (clocks, scores) from cached glyphs
+	obs_properties_add_bool(ppts, "fast_text_render", MT_("fast_text_render"));
+
+	// Marquee: the text is rendered once on one line and scrolled on the GPU
+	obs_properties_add_bool(ppts, "marquee", MT_("marquee"));
+	obs_properties_add_int(ppts, "marquee_speed", MT_("marquee_speed"), 1, 5000, 1);
+
+	// Output statistics of this source
+	obs_properties_add_text(
+		ppts, "stats",
+		(std::string(MT_("stats")) + ": " + format_url_source_stats(usd->stats) + ". " +
+		 format_image_cache_stats())
+			.c_str(),
+		OBS_TEXT_INFO);
+
 	// Add a informative text about the plugin
 	obs_properties_add_text(
 		ppts, "info",
@@ -281,6 +333,93 @@ obs_properties_t *url_source_properties(void *data)
 	return ppts;
 }
 
+uint32_t url_source_get_width(void *data)
+{
+	struct url_source_data *usd = reinterpret_cast<struct url_source_data *>(data);
+	if (usd->marquee && usd->frame_height > 0) {
+		// the marquee scrolls through a window of the render width
+		return usd->render_width;
+	}
+	return usd->frame_width;
+}
+
+uint32_t url_source_get_height(void *data)
+{
+	struct url_source_data *usd = reinterpret_cast<struct url_source_data *>(data);
+	return usd->frame_height;
+}
+
+// space between the end of the marquee text and its next repetition, in text heights
+const float marquee_gap_heights = 2.0f;
+
+void url_source_video_tick(void *data, float seconds)
+{
+	struct url_source_data *usd = reinterpret_cast<struct url_source_data *>(data);
+	if (!usd->marquee) {
+		return;
+	}
+	// video_tick runs outside the graphics context, while the curl thread may be uploading
+	std::lock_guard<std::mutex> lock(usd->layers_mutex);
+	for (render_layer &layer : usd->layers) {
+		if (layer.width == 0) {
+			continue;
+		}
+		const float period =
+			(float)layer.width + marquee_gap_heights * (float)layer.height;
+		layer.marquee_offset = std::fmod(
+			layer.marquee_offset + (float)usd->marquee_speed * seconds, period);
+	}
+}
+
+// Draw a layer's text scrolling right to left and repeating, clipped to the render width
+void draw_marquee_layer(const render_layer &layer, uint32_t render_width, gs_effect_t *effect)
+{
+	const int view_width = (int)render_width;
+	const int text_width = (int)layer.width;
+	const int text_height = (int)layer.height;
+	const int period = text_width + (int)(marquee_gap_heights * (float)text_height);
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), layer.texture);
+	for (int x = -(int)layer.marquee_offset; x < view_width; x += period) {
+		const int left = std::max(x, 0);
+		const int right = std::min(x + text_width, view_width);
+		if (right <= left) {
+			continue;
+		}
+		gs_matrix_push();
+		gs_matrix_translate3f((float)left, 0.0f, 0.0f);
+		gs_draw_sprite_subregion(layer.texture, 0, (uint32_t)(left - x), 0,
+					 (uint32_t)(right - left), (uint32_t)text_height);
+		gs_matrix_pop();
+	}
+}
+
+void url_source_video_render(void *data, gs_effect_t *effect)
+{
+	struct url_source_data *usd = reinterpret_cast<struct url_source_data *>(data);
+	if (usd->frame_height == 0) {
+		return;
+	}
+	// draw the layers uploaded by the internal renders stacked top to bottom, no upload
+	// happens here. The marquee scrolls each layer's texture.
+	uint32_t y = 0;
+	std::lock_guard<std::mutex> lock(usd->layers_mutex);
+	for (const render_layer &layer : usd->layers) {
+		if (layer.texture == nullptr || layer.width == 0 || layer.height == 0) {
+			continue;
+		}
+		if (usd->marquee) {
+			gs_matrix_push();
+			gs_matrix_translate3f(0.0f, (float)y, 0.0f);
+			draw_marquee_layer(layer, usd->render_width, effect);
+			gs_matrix_pop();
+		} else {
+			obs_source_draw(layer.texture, 0, (int)y, 0, 0, false);
+		}
+		y += layer.height;
+	}
+}
+
 void url_source_activate(void *data)
 {
 	if (data == nullptr) {
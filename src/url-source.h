@@ -15,6 +15,10 @@ void url_source_update(void *data, obs_data_t *settings);
 const char *url_source_name(void *unused);
 void url_source_activate(void *data);
 void url_source_deactivate(void *data);
+uint32_t url_source_get_width(void *data);
+uint32_t url_source_get_height(void *data);
+void url_source_video_render(void *data, gs_effect_t *effect);
+void url_source_video_tick(void *data, float seconds);
 
 const char *const PLUGIN_INFO_TEMPLATE =
 	"<a href=\"https://github.com/locaal-ai/obs-urlsource/\">URL/API Source</a> (%1) by "
@@ -14,10 +14,10 @@
 #include <mutex>
 #include <condition_variable>
 
-#include <inja/inja.hpp>
 #include <nlohmann/json.hpp>
 
 #include "request-data.h"
+#include "template-cache.h"
 #include "websocket-client.h"
 #include "plugin-support.h"
 
@@ -145,7 +145,8 @@ struct WebSocketClientWrapper {
 };
 
 struct request_data_handler_response
-websocket_request_handler(url_source_request_data *request_data)
+websocket_request_handler(url_source_request_data *request_data,
+			  url_source_template_cache *templates)
 {
 	request_data_handler_response response;
 
@@ -162,14 +163,14 @@ websocket_request_handler(url_source_request_data *request_data)
 		}
 
 		nlohmann::json json; // json object or variables for inja
-		inja::Environment env;
-		prepare_inja_env(&env, request_data, response, json);
+		prepare_inja_data(request_data, response, json);
 
 		if (response.status_code != URL_SOURCE_REQUEST_SUCCESS) {
 			return response;
 		}
 
-		std::string message = env.render(request_data->body, json);
+		std::string message = render_cached_template(*templates, templates->body,
+							      request_data->body, json);
 
 		if (!request_data->ws_client_wrapper->send(message)) {
 			throw std::runtime_error("Failed to send WebSocket message");
@@ -4,6 +4,7 @@
 #include "request-data.h"
 
 struct request_data_handler_response
-websocket_request_handler(url_source_request_data *request_data);
+websocket_request_handler(url_source_request_data *request_data,
+			  url_source_template_cache *templates);
 
 #endif // WEBSOCKET_CLIENT_H